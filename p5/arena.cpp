@@ -0,0 +1,77 @@
+#include <cstdlib>
+#include <cstdint>
+#include "arena.hpp"
+
+namespace cminusminus{
+
+//Chunks start small, so that a tiny program does not pay for a
+// big arena, and double up to a cap
+static const size_t FIRST_CHUNK_SIZE = 64 * 1024;
+static const size_t MAX_CHUNK_SIZE = 16 * 1024 * 1024;
+
+Arena::Arena() : myNextChunkSize(FIRST_CHUNK_SIZE){
+}
+
+Arena::~Arena(){
+	while (myChunk != nullptr){
+		Chunk * prev = myChunk->prev;
+		free(myChunk);
+		myChunk = prev;
+	}
+}
+
+void Arena::newChunk(size_t minSize){
+	size_t size = myNextChunkSize;
+	minSize += sizeof(Chunk) + alignof(std::max_align_t);
+	if (size < minSize){ size = minSize; }
+	if (myNextChunkSize < MAX_CHUNK_SIZE){ myNextChunkSize *= 2; }
+
+	Chunk * chunk = static_cast<Chunk *>(malloc(size));
+	if (chunk == nullptr){ throw std::bad_alloc(); }
+	chunk->prev = myChunk;
+	myChunk = chunk;
+	myNext = reinterpret_cast<char *>(chunk) + sizeof(Chunk);
+	myEnd = reinterpret_cast<char *>(chunk) + size;
+	myChunks++;
+}
+
+void Arena::adopt(Arena& other){
+	if (other.myChunk == nullptr){ return; }
+	if (myChunk == nullptr){
+		myChunk = other.myChunk;
+		myNext = other.myNext;
+		myEnd = other.myEnd;
+	} else {
+		//Slip other's chunks in below the one being filled
+		Chunk * oldest = other.myChunk;
+		while (oldest->prev != nullptr){ oldest = oldest->prev; }
+		oldest->prev = myChunk->prev;
+		myChunk->prev = other.myChunk;
+	}
+	myAllocations += other.myAllocations;
+	myBytes += other.myBytes;
+	myChunks += other.myChunks;
+	other.myChunk = nullptr;
+	other.myNext = nullptr;
+	other.myEnd = nullptr;
+	other.myAllocations = 0;
+	other.myBytes = 0;
+	other.myChunks = 0;
+}
+
+void * Arena::allocate(size_t size, size_t align){
+	uintptr_t next = reinterpret_cast<uintptr_t>(myNext);
+	uintptr_t aligned = (next + (align - 1)) & ~(uintptr_t(align) - 1);
+	if (myNext == nullptr
+	  || aligned + size > reinterpret_cast<uintptr_t>(myEnd)){
+		newChunk(size + align);
+		next = reinterpret_cast<uintptr_t>(myNext);
+		aligned = (next + (align - 1)) & ~(uintptr_t(align) - 1);
+	}
+	myNext = reinterpret_cast<char *>(aligned + size);
+	myAllocations++;
+	myBytes += size;
+	return reinterpret_cast<void *>(aligned);
+}
+
+}
@@ -0,0 +1,152 @@
+#ifndef CMINUSMINUS_ARENA_HPP
+#define CMINUSMINUS_ARENA_HPP
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+namespace cminusminus{
+
+//A bump allocator that owns the AST nodes, tokens and positions
+// of one compilation. Allocating is a pointer increment, nothing
+// allocated from an arena is ever freed on its own, and the whole
+// arena is released at once (a handful of chunk frees) when it is
+// destroyed. No destructors are run, so objects placed in an arena
+// must not own memory outside of it.
+class Arena{
+public:
+	Arena();
+	~Arena();
+	void * allocate(size_t size, size_t align);
+	//Take over everything allocated from other, which is left
+	// empty. Used to gather what workers allocated in arenas
+	// of their own into the arena of the compilation.
+	void adopt(Arena& other);
+
+	size_t allocations() const { return myAllocations; }
+	size_t bytesAllocated() const { return myBytes; }
+	size_t chunks() const { return myChunks; }
+
+	//The arena that arena objects created on this thread are
+	// placed in. When no arena is active, they fall back to the
+	// heap (and, as before arenas existed, are never freed).
+	static Arena * current(){ return currentRef(); }
+private:
+	friend class ArenaScope;
+	static Arena *& currentRef(){
+		thread_local Arena * active = nullptr;
+		return active;
+	}
+	void newChunk(size_t minSize);
+
+	struct Chunk{
+		Chunk * prev;
+	};
+	Chunk * myChunk = nullptr;
+	char * myNext = nullptr;
+	char * myEnd = nullptr;
+	size_t myNextChunkSize;
+	size_t myAllocations = 0;
+	size_t myBytes = 0;
+	size_t myChunks = 0;
+};
+
+//Makes an arena the current one for as long as the scope lives
+class ArenaScope{
+public:
+	ArenaScope(Arena * arena) : saved(Arena::currentRef()){
+		Arena::currentRef() = arena;
+	}
+	~ArenaScope(){ Arena::currentRef() = saved; }
+private:
+	Arena * saved;
+};
+
+//Allocate from the current arena if there is one, or else
+// from the heap
+inline void * arenaAllocate(size_t size, size_t align){
+	Arena * arena = Arena::current();
+	if (arena == nullptr){ return ::operator new(size); }
+	return arena->allocate(size, align);
+}
+
+//Subclasses are created with plain new-expressions, which are
+// served by the current arena. Deleting one is a no-op: the
+// memory goes back when the arena is destroyed.
+class ArenaObject{
+public:
+	//Arena objects are laid out with pointer alignment
+	static void * operator new(size_t size){
+		return arenaAllocate(size, alignof(void *));
+	}
+	static void operator delete(void *){ }
+};
+
+//A std::allocator replacement that draws from the current arena
+template <typename T>
+class ArenaAllocator{
+public:
+	using value_type = T;
+	ArenaAllocator() = default;
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U>&){ }
+	T * allocate(size_t n){
+		return static_cast<T *>(arenaAllocate(n * sizeof(T), alignof(T)));
+	}
+	void deallocate(T *, size_t){ }
+	template <typename U>
+	bool operator==(const ArenaAllocator<U>&) const { return true; }
+	template <typename U>
+	bool operator!=(const ArenaAllocator<U>&) const { return false; }
+};
+
+//The child lists of AST nodes: a growable array of node
+// pointers, so that walking the children of a node reads
+// contiguous memory rather than chasing a pointer per child.
+// Both the list and its elements live in the current arena.
+// When the list grows its old storage is left behind in the
+// arena, which wastes at most as much as the list now holds.
+template <typename T>
+class NodeList : public ArenaObject{
+	static_assert(std::is_pointer<T>::value,
+		"NodeList elements are copied as plain values");
+public:
+	using value_type = T;
+	using iterator = T *;
+	using const_iterator = const T *;
+
+	void push_back(T elt){
+		if (mySize == myCapacity){ grow(); }
+		myData[mySize++] = elt;
+	}
+	size_t size() const { return mySize; }
+	bool empty() const { return mySize == 0; }
+	iterator begin(){ return myData; }
+	iterator end(){ return myData + mySize; }
+	const_iterator begin() const { return myData; }
+	const_iterator end() const { return myData + mySize; }
+	T front() const { return myData[0]; }
+	T back() const { return myData[mySize - 1]; }
+	T operator[](size_t idx) const { return myData[idx]; }
+private:
+	//Most lists (arguments, formals, short bodies) fit in
+	// the first allocation
+	static const size_t FIRST_CAPACITY = 4;
+
+	void grow(){
+		size_t capacity = myCapacity == 0 ? FIRST_CAPACITY : myCapacity * 2;
+		T * data = static_cast<T *>(
+			arenaAllocate(capacity * sizeof(T), alignof(T)));
+		for (size_t i = 0; i < mySize; i++){ data[i] = myData[i]; }
+		myData = data;
+		myCapacity = capacity;
+	}
+
+	T * myData = nullptr;
+	size_t mySize = 0;
+	size_t myCapacity = 0;
+};
+
+}
+
+#endif
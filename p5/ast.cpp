@@ -1,9 +1,9 @@
 #include "ast.hpp"
 
-cminusminus::ProgramNode::ProgramNode(std::list<DeclNode *> * globalsIn)
-: ASTNode(new Position(0,0,0,0)), myGlobals(globalsIn){
+cminusminus::ProgramNode::ProgramNode(NodeList<DeclNode *> * globalsIn)
+: ASTNode(nullptr), myGlobals(globalsIn){
 	if (!globalsIn->empty()){
-		myPos->expand(
+		myPos.expand(
 			myGlobals->front()->pos(),
 			myGlobals->back()->pos()
 		);
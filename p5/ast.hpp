@@ -5,9 +5,12 @@
 #include <sstream>
 #include <string.h>
 #include <list>
+#include "arena.hpp"
+#include "stats.hpp"
 #include "tokens.hpp"
 #include "symbol_table.hpp"
 #include "types.hpp"
+#include "flat_ast.hpp"
 
 namespace cminusminus {
 
@@ -18,6 +21,7 @@ class SymbolTable;
 class SemSymbol;
 
 class DeclNode;
+class FnDeclNode;
 class VarDeclNode;
 class StmtNode;
 class AssignExpNode;
@@ -27,28 +31,53 @@ class ExpNode;
 class LValNode;
 class IDNode;
 
-class ASTNode{
+class ASTNode : public ArenaObject{
 public:
-	ASTNode(Position * pos) : myPos(pos){ }
+	//The position is copied into the node. A null position
+	// means the node has no place in the source.
+	ASTNode(const Position * pos)
+	: myPos(pos == nullptr ? Position() : *pos), myId(nextId()++){
+		if (Stats * stats = Stats::current()){ stats->noteNode(this); }
+	}
 	virtual void unparse(std::ostream&, int) = 0;
-	Position * pos() { return myPos; };
+	Position * pos() { return &myPos; };
+	//Nodes are numbered densely in the order they are built, so
+	// that per-node facts can be kept in flat arrays indexed by id
+	uint32_t id() const { return myId; }
+	//Start numbering from 0 again for a new AST on this thread
+	static void resetIds(){ nextId() = 0; }
 	std::string posStr(){ return pos()->span(); }
 	virtual bool nameAnalysis(SymbolTable *) = 0;
+	//Append this subtree to a flat table (see FlatAST)
+	virtual void flatten(FlatAST * flat) = 0;
 	//Note that there is no ASTNode::typeAnalysis. To allow
 	// for different type signatures, type analysis is
 	// implemented as needed in various subclasses
 protected:
-	Position * myPos = nullptr;
+	Position myPos;
+private:
+	static uint32_t& nextId(){
+		thread_local uint32_t next = 0;
+		return next;
+	}
+	const uint32_t myId;
 };
 
 class ProgramNode : public ASTNode{
 public:
-	ProgramNode(std::list<DeclNode *> * globalsIn);
+	ProgramNode(NodeList<DeclNode *> * globalsIn);
 	void unparse(std::ostream&, int) override;
+	void flatten(FlatAST * flat) override;
 	virtual bool nameAnalysis(SymbolTable *) override;
 	virtual void typeAnalysis(TypeAnalysis *);
+	//Both analyses in one traversal (see TypeAnalysis::startFused)
+	bool nameAndTypeAnalysis(SymbolTable * symTab, TypeAnalysis * ta);
+	//One more than the largest id in the tree. The root is
+	// built last, so this is the number of nodes in the AST.
+	size_t nodeCount() const { return id() + 1; }
+	const NodeList<DeclNode *> * getGlobals() const { return myGlobals; }
 private:
-	std::list<DeclNode *> * myGlobals;
+	NodeList<DeclNode *> * myGlobals;
 };
 
 class ExpNode : public ASTNode{
@@ -58,6 +87,13 @@ public:
 	virtual void unparseNested(std::ostream& out);
 	virtual bool nameAnalysis(SymbolTable * symTab) override = 0;
 	virtual void typeAnalysis(TypeAnalysis *);
+#ifdef CMM_INLINE_EXP_TYPES
+private:
+	//Only used when expression types are kept on the nodes
+	// themselves (see TypeAnalysis::nodeType)
+	friend class TypeAnalysis;
+	mutable const DataType * myType = nullptr;
+#endif
 };
 
 class LValNode : public ExpNode{
@@ -70,16 +106,18 @@ public:
 
 class IDNode : public LValNode{
 public:
-	IDNode(Position * p, std::string nameIn)
+	IDNode(Position * p, Ident nameIn)
 	: LValNode(p), name(nameIn), mySymbol(nullptr){}
-	std::string getName(){ return name; }
+	const std::string& getName(){ return *name; }
+	Ident getIdent() const { return name; }
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	void attachSymbol(SemSymbol * symbolIn);
 	SemSymbol * getSymbol() const { return mySymbol; }
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 private:
-	std::string name;
+	Ident name;
 	SemSymbol * mySymbol;
 };
 
@@ -103,6 +141,9 @@ public:
 	DeclNode(Position * p) : StmtNode(p){ }
 	void unparse(std::ostream& out, int indent) override =0;
 	virtual void typeAnalysis(TypeAnalysis *) override;
+	//The name being declared
+	virtual IDNode * ID() const = 0;
+	virtual FnDeclNode * asFnDecl(){ return nullptr; }
 };
 
 class VarDeclNode : public DeclNode{
@@ -110,7 +151,8 @@ public:
 	VarDeclNode(Position * p, TypeNode * typeIn, IDNode * IDIn)
 	: DeclNode(p), myType(typeIn), myID(IDIn){ }
 	void unparse(std::ostream& out, int indent) override;
-	IDNode * ID(){ return myID; }
+	void flatten(FlatAST * flat) override;
+	IDNode * ID() const override { return myID; }
 	TypeNode * getTypeNode(){ return myType; }
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
@@ -124,32 +166,43 @@ public:
 	FormalDeclNode(Position * p, TypeNode * type, IDNode * id)
 	: VarDeclNode(p, type, id){ }
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 };
 
 class FnDeclNode : public DeclNode{
 public:
 	FnDeclNode(Position * p,
 	  TypeNode * retTypeIn, IDNode * idIn,
-	  std::list<FormalDeclNode *> * formalsIn,
-	  std::list<StmtNode *> * bodyIn)
+	  NodeList<FormalDeclNode *> * formalsIn,
+	  NodeList<StmtNode *> * bodyIn)
 	: DeclNode(p), myRetType(retTypeIn), myID(idIn),
 	  myFormals(formalsIn), myBody(bodyIn){
 	}
-	IDNode * ID() const { return myID; }
-	std::list<FormalDeclNode *> * getFormals() const{
+	IDNode * ID() const override { return myID; }
+	FnDeclNode * asFnDecl() override { return this; }
+	NodeList<FormalDeclNode *> * getFormals() const{
 		return myFormals;
 	}
 	virtual TypeNode * getRetTypeNode() {
 		return myRetType;
 	}
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	virtual bool nameAnalysis(SymbolTable * symTab) override;
-	virtual void typeAnalysis(TypeAnalysis *) override;
+	//nameAnalysis in two steps. The header declares the
+	// function and leaves its scope open, holding the formals;
+	// the body resolves the statements and closes that scope.
+	bool nameAnalysisHeader(SymbolTable * symTab);
+	bool nameAnalysisBody(SymbolTable * symTab);
+	virtual void typeAnalysis(TypeAnalysis *) override;
+	//Declare the function's type and make it the current one
+	void typeAnalysisHeader(TypeAnalysis * ta);
+	bool nameAndTypeAnalysis(SymbolTable * symTab, TypeAnalysis * ta);
 private:
 	TypeNode * myRetType;
 	IDNode * myID;
-	std::list<FormalDeclNode *> * myFormals;
-	std::list<StmtNode *> * myBody;
+	NodeList<FormalDeclNode *> * myFormals;
+	NodeList<StmtNode *> * myBody;
 };
 
 class AssignStmtNode : public StmtNode{
@@ -157,6 +210,7 @@ public:
 	AssignStmtNode(Position * p, AssignExpNode * expIn)
 	: StmtNode(p), myExp(expIn){ }
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 private:
@@ -168,6 +222,7 @@ public:
 	ReadStmtNode(Position * p, LValNode * dstIn)
 	: StmtNode(p), myDst(dstIn){ }
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 private:
@@ -179,6 +234,7 @@ public:
 	WriteStmtNode(Position * p, ExpNode * srcIn)
 	: StmtNode(p), mySrc(srcIn){ }
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 private:
@@ -190,6 +246,7 @@ public:
 	PostDecStmtNode(Position * p, LValNode * lvalIn)
 	: StmtNode(p), myLVal(lvalIn){ }
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	virtual bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 private:
@@ -201,6 +258,7 @@ public:
 	PostIncStmtNode(Position * p, LValNode * lvalIn)
 	: StmtNode(p), myLVal(lvalIn){ }
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	virtual bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 private:
@@ -210,43 +268,46 @@ private:
 class IfStmtNode : public StmtNode{
 public:
 	IfStmtNode(Position * p, ExpNode * condIn,
-	  std::list<StmtNode *> * bodyIn)
+	  NodeList<StmtNode *> * bodyIn)
 	: StmtNode(p), myCond(condIn), myBody(bodyIn){ }
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 private:
 	ExpNode * myCond;
-	std::list<StmtNode *> * myBody;
+	NodeList<StmtNode *> * myBody;
 };
 
 class IfElseStmtNode : public StmtNode{
 public:
 	IfElseStmtNode(Position * p, ExpNode * condIn,
-	  std::list<StmtNode *> * bodyTrueIn,
-	  std::list<StmtNode *> * bodyFalseIn)
+	  NodeList<StmtNode *> * bodyTrueIn,
+	  NodeList<StmtNode *> * bodyFalseIn)
 	: StmtNode(p), myCond(condIn),
 	  myBodyTrue(bodyTrueIn), myBodyFalse(bodyFalseIn) { }
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 private:
 	ExpNode * myCond;
-	std::list<StmtNode *> * myBodyTrue;
-	std::list<StmtNode *> * myBodyFalse;
+	NodeList<StmtNode *> * myBodyTrue;
+	NodeList<StmtNode *> * myBodyFalse;
 };
 
 class WhileStmtNode : public StmtNode{
 public:
 	WhileStmtNode(Position * p, ExpNode * condIn,
-	  std::list<StmtNode *> * bodyIn)
+	  NodeList<StmtNode *> * bodyIn)
 	: StmtNode(p), myCond(condIn), myBody(bodyIn){ }
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 private:
 	ExpNode * myCond;
-	std::list<StmtNode *> * myBody;
+	NodeList<StmtNode *> * myBody;
 };
 
 class ReturnStmtNode : public StmtNode{
@@ -254,6 +315,7 @@ public:
 	ReturnStmtNode(Position * p, ExpNode * exp)
 	: StmtNode(p), myExp(exp){ }
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 private:
@@ -263,16 +325,17 @@ private:
 class CallExpNode : public ExpNode{
 public:
 	CallExpNode(Position * p, IDNode * id,
-	  std::list<ExpNode *> * argsIn)
+	  NodeList<ExpNode *> * argsIn)
 	: ExpNode(p), myID(id), myArgs(argsIn){ }
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	void unparseNested(std::ostream& out) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 
 private:
 	IDNode * myID;
-	std::list<ExpNode *> * myArgs;
+	NodeList<ExpNode *> * myArgs;
 };
 
 class BinaryExpNode : public ExpNode{
@@ -282,6 +345,7 @@ public:
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 protected:
+	void flattenAs(FlatAST * flat, FlatAST::Kind kind);
 	ExpNode * myExp1;
 	ExpNode * myExp2;
 };
@@ -291,6 +355,7 @@ public:
 	PlusNode(Position * p, ExpNode * e1, ExpNode * e2)
 	: BinaryExpNode(p, e1, e2){ }
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 };
 
@@ -299,6 +364,7 @@ public:
 	MinusNode(Position * p, ExpNode * e1, ExpNode * e2)
 	: BinaryExpNode(p, e1, e2){ }
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 };
 
@@ -307,6 +373,7 @@ public:
 	TimesNode(Position * p, ExpNode * e1In, ExpNode * e2In)
 	: BinaryExpNode(p, e1In, e2In){ }
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 };
 
@@ -315,6 +382,7 @@ public:
 	DivideNode(Position * p, ExpNode * e1, ExpNode * e2)
 	: BinaryExpNode(p, e1, e2){ }
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 };
 
@@ -323,6 +391,7 @@ public:
 	AndNode(Position * p, ExpNode * e1, ExpNode * e2)
 	: BinaryExpNode(p, e1, e2){ }
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 };
 
@@ -331,6 +400,7 @@ public:
 	OrNode(Position * p, ExpNode * e1, ExpNode * e2)
 	: BinaryExpNode(p, e1, e2){ }
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 };
 
@@ -339,6 +409,7 @@ public:
 	EqualsNode(Position * p, ExpNode * e1, ExpNode * e2)
 	: BinaryExpNode(p, e1, e2){ }
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 };
 
@@ -347,6 +418,7 @@ public:
 	NotEqualsNode(Position * p, ExpNode * e1, ExpNode * e2)
 	: BinaryExpNode(p, e1, e2){ }
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 };
 
@@ -355,6 +427,7 @@ public:
 	LessNode(Position * p, ExpNode * e1, ExpNode * e2)
 	: BinaryExpNode(p, e1, e2){ }
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 };
 
@@ -363,6 +436,7 @@ public:
 	LessEqNode(Position * pos, ExpNode * e1, ExpNode * e2)
 	: BinaryExpNode(pos, e1, e2){ }
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 };
 
@@ -371,6 +445,7 @@ public:
 	GreaterNode(Position * p, ExpNode * e1, ExpNode * e2)
 	: BinaryExpNode(p, e1, e2){ }
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 };
 
@@ -379,6 +454,7 @@ public:
 	GreaterEqNode(Position * p, ExpNode * e1, ExpNode * e2)
 	: BinaryExpNode(p, e1, e2){ }
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 };
 
@@ -401,6 +477,7 @@ public:
 	: UnaryExpNode(p, IDIn), myID(IDIn){
 	}
 	virtual void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	virtual bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 protected:
@@ -413,6 +490,7 @@ public:
 	: LValNode(p), myID(IDIn){
 	}
 	virtual void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	virtual bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 protected:
@@ -424,6 +502,7 @@ public:
 	NegNode(Position * p, ExpNode * exp)
 	: UnaryExpNode(p, exp){ }
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 };
@@ -433,6 +512,7 @@ public:
 	NotNode(Position * p, ExpNode * exp)
 	: UnaryExpNode(p, exp){ }
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	void typeAnalysis(TypeAnalysis * ta) override;
 };
@@ -441,6 +521,7 @@ class VoidTypeNode : public TypeNode{
 public:
 	VoidTypeNode(Position * p) : TypeNode(p){}
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	const DataType * getType() override;
 };
 
@@ -449,6 +530,7 @@ public:
 	PtrTypeNode(Position * p, TypeNode * baseTypeIn)
 	:TypeNode(p), myBaseType(baseTypeIn) { }
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	const DataType * getType() override;
 private:
 	TypeNode * myBaseType;
@@ -459,6 +541,7 @@ class IntTypeNode : public TypeNode{
 public:
 	IntTypeNode(Position * p): TypeNode(p){}
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	const DataType * getType() override;
 };
 
@@ -466,6 +549,7 @@ class ShortTypeNode : public TypeNode{
 public:
 	ShortTypeNode(Position * p): TypeNode(p){}
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	const DataType * getType() override;
 };
 
@@ -473,6 +557,7 @@ class BoolTypeNode : public TypeNode{
 public:
 	BoolTypeNode(Position * p): TypeNode(p) { }
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	const DataType * getType() override;
 };
 
@@ -480,6 +565,7 @@ class StringTypeNode : public TypeNode{
 public:
 	StringTypeNode(Position * p): TypeNode(p) { }
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	const DataType * getType() override;
 };
 
@@ -488,6 +574,7 @@ public:
 	AssignExpNode(Position * p, LValNode * dstIn, ExpNode * srcIn)
 	: ExpNode(p), myDst(dstIn), mySrc(srcIn){ }
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 private:
@@ -503,6 +590,7 @@ public:
 		unparse(out, 0);
 	}
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 private:
@@ -517,6 +605,7 @@ public:
 		unparse(out, 0);
 	}
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 private:
@@ -525,16 +614,20 @@ private:
 
 class StrLitNode : public ExpNode{
 public:
-	StrLitNode(Position * p, const std::string strIn)
-	: ExpNode(p), myStr(strIn){ }
+	//The literal's text is not copied; it points into the
+	// source buffer, which outlives the AST
+	StrLitNode(Position * p, const char * textIn, size_t lenIn)
+	: ExpNode(p), myText(textIn), myLen(lenIn){ }
 	virtual void unparseNested(std::ostream& out) override{
 		unparse(out, 0);
 	}
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	bool nameAnalysis(SymbolTable *) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 private:
-	 const std::string myStr;
+	const char * myText;
+	const size_t myLen;
 };
 
 class TrueNode : public ExpNode{
@@ -544,6 +637,7 @@ public:
 		unparse(out, 0);
 	}
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 };
@@ -555,6 +649,7 @@ public:
 		unparse(out, 0);
 	}
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 };
@@ -564,6 +659,7 @@ public:
 	CallStmtNode(Position * p, CallExpNode * expIn)
 	: StmtNode(p), myCallExp(expIn){ }
 	void unparse(std::ostream& out, int indent) override;
+	void flatten(FlatAST * flat) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 private:
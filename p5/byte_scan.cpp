@@ -0,0 +1,226 @@
+#include <cstdlib>
+#include <cstring>
+#include "byte_scan.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CMM_BYTE_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+namespace cminusminus{
+
+static bool isBlank(char c){
+	return c == ' ' || c == '\t' || c == '\n';
+}
+
+static bool isStringStop(char c){
+	return c == '"' || c == '\\' || c == '\n';
+}
+
+static size_t scalarBlanks(const char * text, size_t len){
+	size_t k = 0;
+	while (k < len && isBlank(text[k])){ k++; }
+	return k;
+}
+
+//The C library's memchr is as portable as a loop, and usually
+// faster
+static size_t scalarLineEnd(const char * text, size_t len){
+	const void * newline = memchr(text, '\n', len);
+	if (newline == nullptr){ return len; }
+	return static_cast<size_t>(static_cast<const char *>(newline) - text);
+}
+
+static size_t scalarStringStop(const char * text, size_t len){
+	size_t k = 0;
+	while (k < len && !isStringStop(text[k])){ k++; }
+	return k;
+}
+
+#ifdef CMM_BYTE_SCAN_X86
+
+//Each vector version handles whole vectors, and leaves the
+// last few bytes to the scalar loop so as never to read past
+// the end of the text. A mask has a bit set for each byte
+// that ends the search.
+
+static size_t firstSet(unsigned mask){
+	return static_cast<size_t>(__builtin_ctz(mask));
+}
+
+__attribute__((target("sse2")))
+static __m128i sse2Load(const char * text){
+	return _mm_loadu_si128(reinterpret_cast<const __m128i *>(text));
+}
+
+__attribute__((target("sse2")))
+static size_t sse2Blanks(const char * text, size_t len){
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i tab = _mm_set1_epi8('\t');
+	const __m128i newline = _mm_set1_epi8('\n');
+	size_t k = 0;
+	for (; k + 16 <= len; k += 16){
+		__m128i chunk = sse2Load(text + k);
+		__m128i blank = _mm_or_si128(_mm_cmpeq_epi8(chunk, space),
+			_mm_or_si128(_mm_cmpeq_epi8(chunk, tab),
+			_mm_cmpeq_epi8(chunk, newline)));
+		unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(blank))
+			^ 0xFFFFu;
+		if (mask != 0){ return k + firstSet(mask); }
+	}
+	return k + scalarBlanks(text + k, len - k);
+}
+
+__attribute__((target("sse2")))
+static size_t sse2LineEnd(const char * text, size_t len){
+	const __m128i newline = _mm_set1_epi8('\n');
+	size_t k = 0;
+	for (; k + 16 <= len; k += 16){
+		__m128i chunk = sse2Load(text + k);
+		unsigned mask = static_cast<unsigned>(
+			_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline)));
+		if (mask != 0){ return k + firstSet(mask); }
+	}
+	return k + scalarLineEnd(text + k, len - k);
+}
+
+__attribute__((target("sse2")))
+static size_t sse2StringStop(const char * text, size_t len){
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	const __m128i newline = _mm_set1_epi8('\n');
+	size_t k = 0;
+	for (; k + 16 <= len; k += 16){
+		__m128i chunk = sse2Load(text + k);
+		__m128i stop = _mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+			_mm_or_si128(_mm_cmpeq_epi8(chunk, backslash),
+			_mm_cmpeq_epi8(chunk, newline)));
+		unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(stop));
+		if (mask != 0){ return k + firstSet(mask); }
+	}
+	return k + scalarStringStop(text + k, len - k);
+}
+
+__attribute__((target("avx2")))
+static __m256i avx2Load(const char * text){
+	return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text));
+}
+
+__attribute__((target("avx2")))
+static unsigned avx2Mask(__m256i bytes){
+	return static_cast<unsigned>(_mm256_movemask_epi8(bytes));
+}
+
+__attribute__((target("avx2")))
+static size_t avx2Blanks(const char * text, size_t len){
+	const __m256i space = _mm256_set1_epi8(' ');
+	const __m256i tab = _mm256_set1_epi8('\t');
+	const __m256i newline = _mm256_set1_epi8('\n');
+	size_t k = 0;
+	for (; k + 32 <= len; k += 32){
+		__m256i chunk = avx2Load(text + k);
+		__m256i blank = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, space),
+			_mm256_or_si256(_mm256_cmpeq_epi8(chunk, tab),
+			_mm256_cmpeq_epi8(chunk, newline)));
+		unsigned mask = ~avx2Mask(blank);
+		if (mask != 0){ return k + firstSet(mask); }
+	}
+	return k + sse2Blanks(text + k, len - k);
+}
+
+__attribute__((target("avx2")))
+static size_t avx2LineEnd(const char * text, size_t len){
+	const __m256i newline = _mm256_set1_epi8('\n');
+	size_t k = 0;
+	for (; k + 32 <= len; k += 32){
+		unsigned mask = avx2Mask(
+			_mm256_cmpeq_epi8(avx2Load(text + k), newline));
+		if (mask != 0){ return k + firstSet(mask); }
+	}
+	return k + sse2LineEnd(text + k, len - k);
+}
+
+__attribute__((target("avx2")))
+static size_t avx2StringStop(const char * text, size_t len){
+	const __m256i quote = _mm256_set1_epi8('"');
+	const __m256i backslash = _mm256_set1_epi8('\\');
+	const __m256i newline = _mm256_set1_epi8('\n');
+	size_t k = 0;
+	for (; k + 32 <= len; k += 32){
+		__m256i chunk = avx2Load(text + k);
+		__m256i stop = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote),
+			_mm256_or_si256(_mm256_cmpeq_epi8(chunk, backslash),
+			_mm256_cmpeq_epi8(chunk, newline)));
+		unsigned mask = avx2Mask(stop);
+		if (mask != 0){ return k + firstSet(mask); }
+	}
+	return k + sse2StringStop(text + k, len - k);
+}
+
+#endif
+
+const ByteScan::Kernels * ByteScan::kernelsFor(Level level){
+	static const Kernels scalar = { SCALAR,
+		scalarBlanks, scalarLineEnd, scalarStringStop };
+#ifdef CMM_BYTE_SCAN_X86
+	static const Kernels sse2 = { SSE2,
+		sse2Blanks, sse2LineEnd, sse2StringStop };
+	static const Kernels avx2 = { AVX2,
+		avx2Blanks, avx2LineEnd, avx2StringStop };
+	if (level == AVX2){ return &avx2; }
+	if (level == SSE2){ return &sse2; }
+#endif
+	return &scalar;
+}
+
+bool ByteScan::supported(Level level){
+	switch (level){
+	case SCALAR:
+		return true;
+#ifdef CMM_BYTE_SCAN_X86
+	case SSE2:
+		return __builtin_cpu_supports("sse2");
+	case AVX2:
+		return __builtin_cpu_supports("avx2");
+#endif
+	default:
+		return false;
+	}
+}
+
+const ByteScan::Kernels * ByteScan::choose(){
+	Level best = SCALAR;
+	for (int k = SCALAR; k < NUM_LEVELS; k++){
+		Level level = static_cast<Level>(k);
+		if (supported(level)){ best = level; }
+	}
+	if (const char * cap = getenv("CMM_SIMD")){
+		for (int k = SCALAR; k < best; k++){
+			if (strcmp(cap, levelName(static_cast<Level>(k))) == 0){
+				best = static_cast<Level>(k);
+			}
+		}
+	}
+	const Kernels * chosen = kernelsFor(best);
+	activeRef().store(chosen, std::memory_order_relaxed);
+	return chosen;
+}
+
+void ByteScan::use(Level level){
+	activeRef().store(kernelsFor(level), std::memory_order_relaxed);
+}
+
+ByteScan::Level ByteScan::level(){
+	return kernels()->level;
+}
+
+const char * ByteScan::levelName(Level level){
+	switch (level){
+	case SCALAR: return "scalar";
+	case SSE2: return "sse2";
+	case AVX2: return "avx2";
+	default: return "?";
+	}
+}
+
+}
@@ -0,0 +1,65 @@
+#ifndef CMINUSMINUS_BYTE_SCAN_HPP
+#define CMINUSMINUS_BYTE_SCAN_HPP
+
+#include <atomic>
+#include <cstddef>
+
+namespace cminusminus{
+
+//Searches over raw bytes, which the hand-written scanner uses
+// to skip blanks and to find the ends of comments and string
+// bodies 16 or 32 bytes at a time. Each search has an AVX2 and
+// an SSE2 version as well as a plain one. The best one the CPU
+// supports is chosen the first time any search is used, unless
+// the CMM_SIMD environment variable (scalar, sse2 or avx2)
+// asks for a lower level.
+class ByteScan{
+public:
+	enum Level{ SCALAR, SSE2, AVX2, NUM_LEVELS };
+
+	//The number of bytes at the start of text that are spaces,
+	// tabs or newlines
+	static size_t blanks(const char * text, size_t len){
+		return kernels()->blanks(text, len);
+	}
+	//The offset of the first newline, or len if there is none
+	static size_t lineEnd(const char * text, size_t len){
+		return kernels()->lineEnd(text, len);
+	}
+	//The offset of the first quote, backslash or newline, or
+	// len if there is none
+	static size_t stringStop(const char * text, size_t len){
+		return kernels()->stringStop(text, len);
+	}
+
+	//Whether this CPU can run the given level
+	static bool supported(Level level);
+	//Use the given (supported) level from now on. Meant for
+	// benchmarks and tests; it should not change while another
+	// thread is scanning.
+	static void use(Level level);
+	static Level level();
+	static const char * levelName(Level level);
+private:
+	struct Kernels{
+		Level level;
+		size_t (*blanks)(const char *, size_t);
+		size_t (*lineEnd)(const char *, size_t);
+		size_t (*stringStop)(const char *, size_t);
+	};
+	static const Kernels * kernels(){
+		const Kernels * active =
+			activeRef().load(std::memory_order_relaxed);
+		return active != nullptr ? active : choose();
+	}
+	static const Kernels * choose();
+	static const Kernels * kernelsFor(Level level);
+	static std::atomic<const Kernels *>& activeRef(){
+		static std::atomic<const Kernels *> active(nullptr);
+		return active;
+	}
+};
+
+}
+
+#endif
@@ -45,7 +45,7 @@
   //Request tokens from our scanner member, not 
   // from a global function
   #undef yylex
-  #define yylex scanner.yylex
+  #define yylex scanner.nextToken
 }
 
 %union {
@@ -58,22 +58,22 @@
    cminusminus::StrToken*                      transStrToken;
    cminusminus::ProgramNode*                   transProgram;
    cminusminus::DeclNode *                     transDecl;
-   std::list<cminusminus::DeclNode *> *        transDeclList;
+   cminusminus::NodeList<cminusminus::DeclNode *> * transDeclList;
    cminusminus::VarDeclNode *                  transVarDecl;
-   std::list<cminusminus::VarDeclNode *> *     transVarDeclList;
+   cminusminus::NodeList<cminusminus::VarDeclNode *> * transVarDeclList;
    cminusminus::FormalDeclNode *               transFormal;
-   std::list<cminusminus::FormalDeclNode *> *  transFormalList;
+   cminusminus::NodeList<cminusminus::FormalDeclNode *> * transFormalList;
    cminusminus::TypeNode *                     transType;
    cminusminus::LValNode *                     transLVal;
    cminusminus::IDNode *                       transID;
    cminusminus::FnDeclNode *                   transFn;
-   std::list<cminusminus::VarDeclNode *> *     transVarDecls;
-   std::list<cminusminus::StmtNode *> *        transStmts;
+   cminusminus::NodeList<cminusminus::VarDeclNode *> * transVarDecls;
+   cminusminus::NodeList<cminusminus::StmtNode *> * transStmts;
    cminusminus::StmtNode *                     transStmt;
    cminusminus::ExpNode *                      transExp;
    cminusminus::AssignExpNode *                transAssignExp;
    cminusminus::CallExpNode *                  transCallExp;
-   std::list<cminusminus::ExpNode *> *         transActuals;
+   cminusminus::NodeList<cminusminus::ExpNode *> * transActuals;
 }
 
 %define parse.assert
@@ -168,7 +168,7 @@ globals 	: globals decl
 	  	  }
 		| /* epsilon */
 		  {
-		  $$ = new std::list<DeclNode * >();
+		  $$ = new NodeList<DeclNode *>();
 		  }
 
 decl 		: varDecl
@@ -178,8 +178,8 @@ decl 		: varDecl
 
 varDecl 	: type id SEMICOL
 		  {
-		  Position * p = new Position($1->pos(), $2->pos());
-		  $$ = new VarDeclNode(p, $1, $2);
+		  Position p($1->pos(), $2->pos());
+		  $$ = new VarDeclNode(&p, $1, $2);
 		  }
 
 type		: primType
@@ -188,8 +188,8 @@ type		: primType
 		  }
 		| PTR primType
 		  {
-		  Position * p = new Position($1->pos(), $2->pos());
-		  $$ = new PtrTypeNode(p, $2);
+		  Position p($1->pos(), $2->pos());
+		  $$ = new PtrTypeNode(&p, $2);
 		  }
 primType 	: INT
 	  	  { 
@@ -214,19 +214,19 @@ primType 	: INT
 
 fnDecl 		: type id LPAREN RPAREN LCURLY stmtList RCURLY
 		  {
-		  Position * pos = new Position($1->pos(), $7->pos());
-		  std::list<FormalDeclNode *> * f = new std::list<FormalDeclNode *>();
-		  $$ = new FnDeclNode(pos, $1, $2, f, $6);
+		  Position pos($1->pos(), $7->pos());
+		  NodeList<FormalDeclNode *> * f = new NodeList<FormalDeclNode *>();
+		  $$ = new FnDeclNode(&pos, $1, $2, f, $6);
 		  }
 		| type id LPAREN formals RPAREN LCURLY stmtList RCURLY
 		  {
-		  Position * pos = new Position($1->pos(), $8->pos());
-		  $$ = new FnDeclNode(pos, $1, $2, $4, $7);
+		  Position pos($1->pos(), $8->pos());
+		  $$ = new FnDeclNode(&pos, $1, $2, $4, $7);
 		  }
 
 formals 	: formalDecl
 		  {
-		  $$ = new std::list<FormalDeclNode *>();
+		  $$ = new NodeList<FormalDeclNode *>();
 		  $$->push_back($1);
 		  }
 		| formals COMMA formalDecl
@@ -237,13 +237,13 @@ formals 	: formalDecl
 
 formalDecl 	: type id
 		  {
-		  Position * pos = new Position($1->pos(), $2->pos());
-		  $$ = new FormalDeclNode(pos, $1, $2);
+		  Position pos($1->pos(), $2->pos());
+		  $$ = new FormalDeclNode(&pos, $1, $2);
 		  }
 
 stmtList 	: /* epsilon */
 	   	  {
-		  $$ = new std::list<StmtNode *>();
+		  $$ = new NodeList<StmtNode *>();
 	   	  }
 		| stmtList stmt
 	  	  {
@@ -258,158 +258,158 @@ stmt		: varDecl
 		  }
 		| assignExp SEMICOL
 		  {
-		  Position * p = new Position($1->pos(), $2->pos());
-		  $$ = new AssignStmtNode(p, $1); 
+		  Position p($1->pos(), $2->pos());
+		  $$ = new AssignStmtNode(&p, $1); 
 		  }
 		| lval DEC SEMICOL
 		  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new PostDecStmtNode(p, $1);
+		  Position p($1->pos(), $3->pos());
+		  $$ = new PostDecStmtNode(&p, $1);
 		  }
 		| lval INC SEMICOL
 		  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new PostIncStmtNode(p, $1);
+		  Position p($1->pos(), $3->pos());
+		  $$ = new PostIncStmtNode(&p, $1);
 		  }
 		| READ lval SEMICOL
 		  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new ReadStmtNode(p, $2);
+		  Position p($1->pos(), $3->pos());
+		  $$ = new ReadStmtNode(&p, $2);
 		  }
 		| WRITE exp SEMICOL
 		  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new WriteStmtNode(p, $2);
+		  Position p($1->pos(), $3->pos());
+		  $$ = new WriteStmtNode(&p, $2);
 		  }
 		| WHILE LPAREN exp RPAREN LCURLY stmtList RCURLY
 		  {
-		  Position * p = new Position($1->pos(), $7->pos());
-		  $$ = new WhileStmtNode(p, $3, $6);
+		  Position p($1->pos(), $7->pos());
+		  $$ = new WhileStmtNode(&p, $3, $6);
 		  }
 		| IF LPAREN exp RPAREN LCURLY stmtList RCURLY
 		  {
-		  Position * p = new Position($1->pos(), $7->pos());
-		  $$ = new IfStmtNode(p, $3, $6);
+		  Position p($1->pos(), $7->pos());
+		  $$ = new IfStmtNode(&p, $3, $6);
 		  }
 		| IF LPAREN exp RPAREN LCURLY stmtList RCURLY ELSE LCURLY stmtList RCURLY
 		  {
-		  Position * p = new Position($1->pos(), $11->pos());
-		  $$ = new IfElseStmtNode(p, $3, $6, $10);
+		  Position p($1->pos(), $11->pos());
+		  $$ = new IfElseStmtNode(&p, $3, $6, $10);
 		  }
 		| RETURN exp SEMICOL
 		  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new ReturnStmtNode(p, $2);
+		  Position p($1->pos(), $3->pos());
+		  $$ = new ReturnStmtNode(&p, $2);
 		  }
 		| RETURN SEMICOL
 		  {
-		  Position * p = new Position($1->pos(), $2->pos());
-		  $$ = new ReturnStmtNode(p, nullptr);
+		  Position p($1->pos(), $2->pos());
+		  $$ = new ReturnStmtNode(&p, nullptr);
 		  }
 		| callExp SEMICOL
 		  { 
-		  Position * p = new Position($1->pos(), $2->pos());
-		  $$ = new CallStmtNode(p, $1); 
+		  Position p($1->pos(), $2->pos());
+		  $$ = new CallStmtNode(&p, $1); 
 		  }
 
 exp		: assignExp 
 		  { $$ = $1; } 
 		| exp MINUS exp
 	  	  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new MinusNode(p, $1, $3);
+		  Position p($1->pos(), $3->pos());
+		  $$ = new MinusNode(&p, $1, $3);
 		  }
 		| exp PLUS exp
 	  	  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new PlusNode(p, $1, $3);
+		  Position p($1->pos(), $3->pos());
+		  $$ = new PlusNode(&p, $1, $3);
 		  }
 		| exp TIMES exp
 	  	  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new TimesNode(p, $1, $3);
+		  Position p($1->pos(), $3->pos());
+		  $$ = new TimesNode(&p, $1, $3);
 		  }
 		| exp DIVIDE exp
 	  	  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new DivideNode(p, $1, $3);
+		  Position p($1->pos(), $3->pos());
+		  $$ = new DivideNode(&p, $1, $3);
 		  }
 		| exp AND exp
 	  	  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new AndNode(p, $1, $3);
+		  Position p($1->pos(), $3->pos());
+		  $$ = new AndNode(&p, $1, $3);
 		  }
 		| exp OR exp
 	  	  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new OrNode(p, $1, $3);
+		  Position p($1->pos(), $3->pos());
+		  $$ = new OrNode(&p, $1, $3);
 		  }
 		| exp EQUALS exp
 	  	  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new EqualsNode(p, $1, $3);
+		  Position p($1->pos(), $3->pos());
+		  $$ = new EqualsNode(&p, $1, $3);
 		  }
 		| exp NOTEQUALS exp
 	  	  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new NotEqualsNode(p, $1, $3);
+		  Position p($1->pos(), $3->pos());
+		  $$ = new NotEqualsNode(&p, $1, $3);
 		  }
 		| exp GREATER exp
 	  	  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new GreaterNode(p, $1, $3);
+		  Position p($1->pos(), $3->pos());
+		  $$ = new GreaterNode(&p, $1, $3);
 		  }
 		| exp GREATEREQ exp
 	  	  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new GreaterEqNode(p, $1, $3);
+		  Position p($1->pos(), $3->pos());
+		  $$ = new GreaterEqNode(&p, $1, $3);
 		  }
 		| exp LESS exp
 	  	  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new LessNode(p, $1, $3);
+		  Position p($1->pos(), $3->pos());
+		  $$ = new LessNode(&p, $1, $3);
 		  }
 		| exp LESSEQ exp
 	  	  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new LessEqNode(p, $1, $3);
+		  Position p($1->pos(), $3->pos());
+		  $$ = new LessEqNode(&p, $1, $3);
 		  }
 		| NOT exp
 	  	  {
-		  Position * p = new Position($1->pos(), $2->pos());
-		  $$ = new NotNode(p, $2);
+		  Position p($1->pos(), $2->pos());
+		  $$ = new NotNode(&p, $2);
 		  }
 		| MINUS term
 	  	  {
-		  Position * p = new Position($1->pos(), $2->pos());
-		  $$ = new NegNode(p, $2);
+		  Position p($1->pos(), $2->pos());
+		  $$ = new NegNode(&p, $2);
 		  }
 		| term
 	  	  { $$ = $1; }
 
 assignExp	: lval ASSIGN exp
 		  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new AssignExpNode(p, $1, $3);
+		  Position p($1->pos(), $3->pos());
+		  $$ = new AssignExpNode(&p, $1, $3);
 		  }
 
 callExp		: id LPAREN RPAREN
 		  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  std::list<ExpNode *> * noargs =
-		    new std::list<ExpNode *>();
-		  $$ = new CallExpNode(p, $1, noargs);
+		  Position p($1->pos(), $3->pos());
+		  NodeList<ExpNode *> * noargs =
+		    new NodeList<ExpNode *>();
+		  $$ = new CallExpNode(&p, $1, noargs);
 		  }
 		| id LPAREN actualsList RPAREN
 		  {
-		  Position * p = new Position($1->pos(), $4->pos());
-		  $$ = new CallExpNode(p, $1, $3);
+		  Position p($1->pos(), $4->pos());
+		  $$ = new CallExpNode(&p, $1, $3);
 		  }
 
 actualsList	: exp
 		  {
-		  std::list<ExpNode *> * list =
-		    new std::list<ExpNode *>();
+		  NodeList<ExpNode *> * list =
+		    new NodeList<ExpNode *>();
 		  list->push_back($1);
 		  $$ = list;
 		  }
@@ -426,7 +426,7 @@ term 		: lval
 		| SHORTLITERAL 
 		  { $$ = new ShortLitNode($1->pos(), $1->num()); }
 		| STRLITERAL 
-		  { $$ = new StrLitNode($1->pos(), $1->str()); }
+		  { $$ = new StrLitNode($1->pos(), $1->text(), $1->length()); }
 		| AMP id
 		  { $$ = new RefNode($1->pos(), $2); }
 		| TRUE
@@ -446,8 +446,8 @@ lval		: id
 		  }
 		| AT id
 		  {
-		  Position * pos = new Position($1->pos(), $2->pos());
-		  $$ = new DerefNode(pos, $2);
+		  Position pos($1->pos(), $2->pos());
+		  $$ = new DerefNode(&pos, $2);
 		  }
 
 id		: ID
@@ -459,6 +459,6 @@ id		: ID
 %%
 
 void cminusminus::Parser::error(const std::string& msg){
-	std::cout << msg << std::endl;
-	std::cerr << "syntax error" << std::endl;
+	cminusminus::Report::out() << msg << std::endl;
+	cminusminus::Report::err() << "syntax error" << std::endl;
 }
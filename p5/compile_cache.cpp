@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "compile_cache.hpp"
+#include "stats.hpp"
+
+namespace cminusminus{
+
+static const char MAGIC[8] = { 'C', 'M', 'M', 'C', 'A', 'C', 'H', 'E' };
+//Bump whenever the layout of an entry changes
+static const uint32_t FORMAT_VERSION = 1;
+static const char * const SUFFIX = ".entry";
+
+//Two 64-bit lanes of a multiply-xorshift hash, taken a word at
+// a time so that hashing a large input costs little next to
+// compiling it
+class KeyHash{
+public:
+	void add(const char * data, size_t size){
+		size_t k = 0;
+		for (; k + 8 <= size; k += 8){
+			uint64_t word;
+			memcpy(&word, data + k, 8);
+			mix(word);
+		}
+		uint64_t tail = 0;
+		if (size > k){ memcpy(&tail, data + k, size - k); }
+		//The length keeps "ab" and "ab\0" apart
+		mix(tail ^ (static_cast<uint64_t>(size) << 56));
+	}
+	void add(const std::string& text){ add(text.data(), text.size()); }
+	std::string hex() const{
+		char buf[33];
+		snprintf(buf, sizeof(buf), "%016llx%016llx",
+			static_cast<unsigned long long>(lo),
+			static_cast<unsigned long long>(hi));
+		return buf;
+	}
+private:
+	void mix(uint64_t word){
+		lo = (lo ^ word) * 0x9e3779b97f4a7c15ULL;
+		lo ^= lo >> 32;
+		hi = (hi ^ word) * 0xff51afd7ed558ccdULL;
+		hi ^= hi >> 29;
+	}
+	uint64_t lo = 0xcbf29ce484222325ULL;
+	uint64_t hi = 0x84222325cbf29ce4ULL;
+};
+
+CompileCache::CompileCache(const std::string& dirIn, size_t maxBytesIn)
+: dir(dirIn), maxBytes(maxBytesIn){
+	//A missing directory is made; any other problem shows up
+	// as every entry missing
+	mkdir(dir.c_str(), 0777);
+}
+
+const std::string& CompileCache::buildID(){
+	static const std::string id = []{
+		std::ifstream exe("/proc/self/exe", std::ios::binary);
+		std::stringstream bytes;
+		bytes << exe.rdbuf();
+		if (!exe.good() || bytes.str().empty()){
+			return std::string(__DATE__ " " __TIME__);
+		}
+		KeyHash hash;
+		hash.add(bytes.str());
+		return hash.hex();
+	}();
+	return id;
+}
+
+std::string CompileCache::key(const char * data, size_t size,
+	const std::string& flags) const{
+	KeyHash hash;
+	hash.add(buildID());
+	hash.add(flags);
+	hash.add(data, size);
+	return hash.hex();
+}
+
+std::string CompileCache::entryPath(const std::string& key) const{
+	return dir + "/" + key + SUFFIX;
+}
+
+//Reads the fields of an entry in order, failing (rather than
+// reading past the end) if the entry is cut short
+class EntryReader{
+public:
+	EntryReader(const std::string& textIn) : text(textIn){ }
+	bool bytes(void * dest, size_t len){
+		if (len > text.size() - offset){ return false; }
+		memcpy(dest, text.data() + offset, len);
+		offset += len;
+		return true;
+	}
+	bool str(std::string& dest){
+		uint64_t len;
+		if (!bytes(&len, sizeof(len))){ return false; }
+		if (len > text.size() - offset){ return false; }
+		dest.assign(text, offset, static_cast<size_t>(len));
+		offset += static_cast<size_t>(len);
+		return true;
+	}
+	bool atEnd() const { return offset == text.size(); }
+private:
+	const std::string& text;
+	size_t offset = 0;
+};
+
+static void writeStr(std::ostream& out, const std::string& str){
+	uint64_t len = str.size();
+	out.write(reinterpret_cast<const char *>(&len), sizeof(len));
+	out.write(str.data(), static_cast<std::streamsize>(str.size()));
+}
+
+bool CompileCache::lookup(const std::string& key, CachedCompile& entry){
+	Stats * stats = Stats::current();
+	std::string path = entryPath(key);
+	std::ifstream in(path, std::ios::binary);
+	std::stringstream contents;
+	if (in.good()){ contents << in.rdbuf(); }
+	std::string text = contents.str();
+	if (!in.good() || text.empty()){
+		if (stats != nullptr){ stats->cacheMisses++; }
+		return false;
+	}
+
+	EntryReader reader(text);
+	char magic[sizeof(MAGIC)];
+	uint32_t version = 0;
+	int32_t status = 0;
+	uint32_t fileMask = 0;
+	bool ok = reader.bytes(magic, sizeof(magic))
+		&& memcmp(magic, MAGIC, sizeof(MAGIC)) == 0
+		&& reader.bytes(&version, sizeof(version))
+		&& version == FORMAT_VERSION
+		&& reader.bytes(&status, sizeof(status))
+		&& reader.bytes(&fileMask, sizeof(fileMask))
+		&& reader.str(entry.out) && reader.str(entry.err);
+	for (int k = 0; ok && k < CachedCompile::NUM_OUTPUTS; k++){
+		entry.hasFile[k] = (fileMask & (1u << k)) != 0;
+		if (entry.hasFile[k]){ ok = reader.str(entry.files[k]); }
+	}
+	if (!ok || !reader.atEnd()){
+		remove(path.c_str());
+		if (stats != nullptr){ stats->cacheMisses++; }
+		return false;
+	}
+	entry.status = status;
+
+	//Mark the entry as recently used
+	utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+	if (stats != nullptr){ stats->cacheHits++; }
+	return true;
+}
+
+void CompileCache::store(const std::string& key,
+	const CachedCompile& entry){
+	if (!entry.cacheable){ return; }
+	static std::atomic<unsigned> tmpCount(0);
+	std::string path = entryPath(key);
+	std::string tmpPath = path + ".tmp." + std::to_string(getpid())
+		+ "." + std::to_string(tmpCount++);
+	{
+		std::ofstream out(tmpPath, std::ios::binary);
+		if (!out.good()){ return; }
+		uint32_t fileMask = 0;
+		for (int k = 0; k < CachedCompile::NUM_OUTPUTS; k++){
+			if (entry.hasFile[k]){ fileMask |= 1u << k; }
+		}
+		int32_t status = entry.status;
+		out.write(MAGIC, sizeof(MAGIC));
+		out.write(reinterpret_cast<const char *>(&FORMAT_VERSION),
+			sizeof(FORMAT_VERSION));
+		out.write(reinterpret_cast<const char *>(&status), sizeof(status));
+		out.write(reinterpret_cast<const char *>(&fileMask),
+			sizeof(fileMask));
+		writeStr(out, entry.out);
+		writeStr(out, entry.err);
+		for (int k = 0; k < CachedCompile::NUM_OUTPUTS; k++){
+			if (entry.hasFile[k]){ writeStr(out, entry.files[k]); }
+		}
+		out.close();
+		if (!out.good()){
+			remove(tmpPath.c_str());
+			return;
+		}
+	}
+	if (rename(tmpPath.c_str(), path.c_str()) != 0){
+		remove(tmpPath.c_str());
+		return;
+	}
+	evict();
+}
+
+//Remove the least recently used entries until the directory
+// holds no more than maxBytes of them
+void CompileCache::evict(){
+	struct Entry{
+		struct timespec used;
+		size_t bytes;
+		std::string path;
+	};
+	std::lock_guard<std::mutex> guard(evictLock);
+	DIR * listing = opendir(dir.c_str());
+	if (listing == nullptr){ return; }
+	std::vector<Entry> entries;
+	size_t total = 0;
+	const size_t suffixLen = strlen(SUFFIX);
+	while (struct dirent * item = readdir(listing)){
+		size_t len = strlen(item->d_name);
+		if (len <= suffixLen
+			|| strcmp(item->d_name + len - suffixLen, SUFFIX) != 0){
+			continue;
+		}
+		std::string path = dir + "/" + item->d_name;
+		struct stat info;
+		if (stat(path.c_str(), &info) != 0){ continue; }
+		size_t bytes = static_cast<size_t>(info.st_size);
+		entries.push_back(Entry{info.st_mtim, bytes, path});
+		total += bytes;
+	}
+	closedir(listing);
+	if (total <= maxBytes){ return; }
+
+	std::sort(entries.begin(), entries.end(),
+		[](const Entry& a, const Entry& b){
+			if (a.used.tv_sec != b.used.tv_sec){
+				return a.used.tv_sec < b.used.tv_sec;
+			}
+			return a.used.tv_nsec < b.used.tv_nsec;
+		});
+	for (const Entry& entry : entries){
+		if (total <= maxBytes){ break; }
+		//Another compiler may have evicted it already
+		remove(entry.path.c_str());
+		total -= entry.bytes;
+	}
+}
+
+}
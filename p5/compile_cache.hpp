@@ -0,0 +1,72 @@
+#ifndef CMINUSMINUS_COMPILE_CACHE_HPP
+#define CMINUSMINUS_COMPILE_CACHE_HPP
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace cminusminus{
+
+//Everything one compilation wrote, as kept in the cache
+struct CachedCompile{
+	//The outputs that can go to a file of their own
+	enum Output{ TOKENS, UNPARSE, NAMES, NUM_OUTPUTS };
+
+	int status = 0;
+	//What went to stdout (including any output written to
+	// "--") and to stderr
+	std::string out;
+	std::string err;
+	//The outputs that were written to files
+	bool hasFile[NUM_OUTPUTS] = {};
+	std::string files[NUM_OUTPUTS];
+	//Cleared when the result depends on more than the input
+	// and flags (an output file could not be opened), so that
+	// it is not stored
+	bool cacheable = true;
+};
+
+//An on-disk cache of compilations. An entry is keyed by a hash
+// of the input's bytes, the compiler build and the flags that
+// shape the output, and holds everything the compilation wrote
+// along with its exit status, so that a hit can be replayed
+// without scanning or parsing.
+//
+//Each entry is a file in the cache directory. A hit refreshes
+// the entry's modification time, and storing an entry evicts
+// the least recently used ones until the directory is within
+// its size bound. Entries are written to a temporary file and
+// renamed into place, so that concurrent compilers (or batch
+// workers) sharing a directory never see a partial entry.
+//
+//The hash is not cryptographic: the directory should only be
+// writable by those trusted to write cmmc's outputs.
+class CompileCache{
+public:
+	CompileCache(const std::string& dirIn, size_t maxBytesIn);
+
+	//The key of compiling size bytes at data with the given
+	// flags, under this build of the compiler
+	std::string key(const char * data, size_t size,
+		const std::string& flags) const;
+	//Fill entry from the cache, returning false on a miss.
+	// Damaged entries are removed and count as misses.
+	bool lookup(const std::string& key, CachedCompile& entry);
+	void store(const std::string& key, const CachedCompile& entry);
+
+	//Identifies the compiler binary, so that a rebuilt cmmc
+	// does not replay the outputs of an older one
+	static const std::string& buildID();
+private:
+	std::string entryPath(const std::string& key) const;
+	void evict();
+
+	std::string dir;
+	size_t maxBytes;
+	//Eviction scans the whole directory; one at a time will do
+	std::mutex evictLock;
+};
+
+}
+
+#endif
@@ -0,0 +1,94 @@
+#include <algorithm>
+#include "diagnostics.hpp"
+#include "errors.hpp"
+
+namespace cminusminus{
+
+void Diagnostics::configure(size_t errorLimit, bool sortIn){
+	myDiags.clear();
+	myErrors = 0;
+	myLimit = errorLimit;
+	sorted = sortIn;
+}
+
+void Diagnostics::report(Severity severity, const Position& pos,
+	const char * msg){
+	//The text is built now, while the source buffer that the
+	// position refers to is certain to be alive
+	std::string text = severity == FATAL ? "FATAL " : "WARNING ";
+	text += pos.span();
+	text += ": ";
+	text += msg;
+	text += "\n";
+	myDiags.push_back(Diagnostic{severity, pos, std::move(text)});
+	if (severity == FATAL){ countError(); }
+}
+
+void Diagnostics::append(Diagnostics& other){
+	for (Diagnostic& diag : other.myDiags){
+		myDiags.push_back(std::move(diag));
+		if (myDiags.back().severity == FATAL){ countError(); }
+	}
+	other.myDiags.clear();
+}
+
+void Diagnostics::countError(){
+	myErrors++;
+	if (myLimit != 0 && myErrors >= myLimit){
+		throw new ErrorLimitReached(myLimit);
+	}
+}
+
+void Diagnostics::flush(std::ostream& out){
+	if (sorted){
+		std::stable_sort(myDiags.begin(), myDiags.end(),
+			[](const Diagnostic& a, const Diagnostic& b){
+				if (a.pos.file() != b.pos.file()){
+					return a.pos.file() < b.pos.file();
+				}
+				if (a.pos.startOffset() != b.pos.startOffset()){
+					return a.pos.startOffset() < b.pos.startOffset();
+				}
+				return a.pos.endOffset() < b.pos.endOffset();
+			});
+	}
+	size_t size = 0;
+	for (const Diagnostic& diag : myDiags){ size += diag.text.size(); }
+	std::string all;
+	all.reserve(size);
+	for (const Diagnostic& diag : myDiags){ all += diag.text; }
+	myDiags.clear();
+	out.write(all.data(), static_cast<std::streamsize>(all.size()));
+	out.flush();
+}
+
+
+void HeldDiagnostics::hold(size_t index, Diagnostics& diags){
+	held.push_back(Held{index, Diagnostics()});
+	held.back().diags.append(diags);
+}
+
+void HeldDiagnostics::pass(size_t index) const{
+	if (held.empty()){ return; }
+	auto first = std::lower_bound(held.begin(), held.end(), index,
+		[](const Held& entry, size_t at){ return entry.index < at; });
+	for (auto it = first; it != held.end() && it->index == index; ++it){
+		Diagnostics copy = it->diags;
+		Diagnostics::current().append(copy);
+	}
+}
+
+void HeldDiagnostics::passAll(){
+	for (Held& entry : held){
+		Diagnostics::current().append(entry.diags);
+	}
+	held.clear();
+}
+
+void HeldDiagnostics::append(const HeldDiagnostics& other, size_t shift){
+	for (const Held& entry : other.held){
+		held.push_back(Held{entry.index + shift, entry.diags});
+	}
+}
+
+}
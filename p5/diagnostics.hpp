@@ -0,0 +1,109 @@
+#ifndef CMINUSMINUS_DIAGNOSTICS_HPP
+#define CMINUSMINUS_DIAGNOSTICS_HPP
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include "position.hpp"
+
+namespace cminusminus{
+
+//Collects the diagnostics of a compilation in memory and writes
+// them out together, rather than making a write to stderr for
+// each one. Each thread has its own engine (see current()), so
+// the files of a batch never share one.
+class Diagnostics{
+public:
+	enum Severity{ WARNING, FATAL };
+
+	struct Diagnostic{
+		Severity severity;
+		Position pos;
+		//The complete output line, including the newline
+		std::string text;
+	};
+
+	//The engine for the calling thread (see DiagnosticsScope)
+	static Diagnostics& current(){ return *currentRef(); }
+
+	//Start a new compilation. Once errorLimit errors have been
+	// reported (if it is not 0) the compilation is abandoned by
+	// throwing an ErrorLimitReached. With sortIn set, each flush writes
+	// its diagnostics in source order rather than the order in
+	// which they were reported.
+	void configure(size_t errorLimit, bool sortIn);
+
+	void report(Severity severity, const Position& pos,
+		const char * msg);
+
+	bool pending() const { return !myDiags.empty(); }
+	size_t errors() const { return myErrors; }
+
+	//Move other's pending diagnostics to the end of these, as
+	// if they had been reported here. The error limit applies
+	// as they are added.
+	void append(Diagnostics& other);
+
+	//Write out and forget every pending diagnostic
+	void flush(std::ostream& out);
+private:
+	friend class DiagnosticsScope;
+	static Diagnostics *& currentRef(){
+		thread_local Diagnostics own;
+		thread_local Diagnostics * active = &own;
+		return active;
+	}
+	void countError();
+
+	std::vector<Diagnostic> myDiags;
+	size_t myErrors = 0;
+	size_t myLimit = 0;
+	bool sorted = false;
+};
+
+//Diagnostics set aside when a whole file is lexed before it is
+// parsed. Each is held with the index of the token it was
+// reported before, and passed on when the parser takes that
+// token, so that the parser reports the same errors as when it
+// pulls tokens from a live scanner (which it stops doing at a
+// syntax error).
+class HeldDiagnostics{
+public:
+	//Hold (and take from diags) what was reported before the
+	// token at index
+	void hold(size_t index, Diagnostics& diags);
+	//Report what was held for the token at index. It stays
+	// held, so that the tokens can be parsed again.
+	void pass(size_t index) const;
+	//Report everything held, which is then forgotten
+	void passAll();
+	//Hold what other holds as well, with its indices moved up
+	// by shift. Every index of other must be at least that of
+	// the last one held here, less shift.
+	void append(const HeldDiagnostics& other, size_t shift);
+private:
+	struct Held{
+		size_t index;
+		Diagnostics diags;
+	};
+	//In order of index
+	std::vector<Held> held;
+};
+
+//Makes a Diagnostics the current one for as long as the scope
+// lives. Workers that check part of a file report into their
+// own engine, which is then appended to the file's in order.
+class DiagnosticsScope{
+public:
+	DiagnosticsScope(Diagnostics * diags)
+	: saved(Diagnostics::currentRef()){
+		Diagnostics::currentRef() = diags;
+	}
+	~DiagnosticsScope(){ Diagnostics::currentRef() = saved; }
+private:
+	Diagnostics * saved;
+};
+
+}
+
+#endif
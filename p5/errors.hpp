@@ -7,6 +7,8 @@
 #define TODO(x) throw new ToDoError(CODELOC #x);
 
 #include <iostream>
+#include <string>
+#include "diagnostics.hpp"
 #include "position.hpp"
 
 namespace cminusminus{
@@ -32,6 +34,20 @@ private:
 	std::string myMsg;
 };
 
+/* This class is thrown when a compilation has reported as
+   many errors as the -error-limit allows. It is not a mistake
+   of its own: the message is written out as a plain line after
+   the errors, and the file fails. */
+class ErrorLimitReached{
+public:
+	ErrorLimitReached(size_t limitIn) : myLimit(limitIn){}
+	std::string msg(){
+		return "Too many errors (limit " + std::to_string(myLimit)
+			+ "), stopping";
+	}
+private:
+	size_t myLimit;
+};
 
 /* Instances of this class are thrown to denote a situation where you
    (the student) probably need to fill in / change some functionality.
@@ -47,25 +63,54 @@ private:
 
 /* This class is used to encapsulate error messages that the 
    user of the compiler will see in cases where the spec wants 
-   a specific output format. */
+   a specific output format. Messages are held by the thread's
+   Diagnostics engine and written out the next time anything
+   else is written to err(), or when flushDiagnostics is called. */
 class Report{
 public:
 	static void fatal(
-		Position * pos,
+		const Position * pos,
 		const char * msg
 	){
-		std::cerr << "FATAL " 
-		<< pos->span()
-		<< ": " 
-		<< msg  << std::endl;
+		Diagnostics::current().report(Diagnostics::FATAL, *pos, msg);
 	}
 
 	static void fatal(
-		Position * pos,
+		const Position * pos,
 		const std::string msg
 	){
 		fatal(pos,msg.c_str());
 	}
+
+	static void flushDiagnostics(){
+		Diagnostics& diags = Diagnostics::current();
+		if (diags.pending()){ diags.flush(*errTarget()); }
+	}
+
+	//The streams that user-facing output and diagnostics are
+	// written to. They default to std::cout and std::cerr, but
+	// each thread can point its own elsewhere (batch mode gives
+	// every input file its own buffers so that the output of
+	// concurrent compilations does not interleave)
+	static std::ostream& out(){ return *outTarget(); }
+	static std::ostream& err(){
+		//Anything reported so far comes before what is written now
+		flushDiagnostics();
+		return *errTarget();
+	}
+	static void redirect(std::ostream * outIn, std::ostream * errIn){
+		outTarget() = outIn;
+		errTarget() = errIn;
+	}
+private:
+	static std::ostream *& outTarget(){
+		thread_local std::ostream * target = &std::cout;
+		return target;
+	}
+	static std::ostream *& errTarget(){
+		thread_local std::ostream * target = &std::cerr;
+		return target;
+	}
 };
 
 }
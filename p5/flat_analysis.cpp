@@ -0,0 +1,508 @@
+#include "flat_analysis.hpp"
+#include "errName.hpp"
+#include "type_analysis.hpp"
+
+namespace cminusminus{
+
+FlatNameAnalysis * FlatNameAnalysis::build(const FlatAST * astIn){
+	FlatNameAnalysis * names = new FlatNameAnalysis(astIn);
+	SymbolTable symTab;
+	if (!names->analyze(astIn->root(), &symTab)){
+		delete names;
+		return nullptr;
+	}
+	return names;
+}
+
+const DataType * flatTypeOf(const FlatAST * ast, FlatAST::Index node){
+	switch (ast->kind(node)){
+	case FlatAST::VOID_TYPE: return BasicType::VOID();
+	case FlatAST::INT_TYPE: return BasicType::INT();
+	case FlatAST::SHORT_TYPE: return BasicType::SHORT();
+	case FlatAST::BOOL_TYPE: return BasicType::BOOL();
+	case FlatAST::STRING_TYPE: return BasicType::STRING();
+	case FlatAST::PTR_TYPE:
+		return PtrType::produce(flatTypeOf(ast, ast->child(node, 0)));
+	default:
+		throw new InternalError("Not a type node");
+	}
+}
+
+//As in the pointer AST, every child is resolved even once
+// one of them has failed
+bool FlatNameAnalysis::analyze(FlatAST::Index node, SymbolTable * symTab){
+	const FlatAST::Index * kids = ast->children(node);
+	uint32_t numKids = ast->childCount(node);
+	switch (ast->kind(node)){
+	case FlatAST::PROGRAM: {
+		symTab->enterScope();
+		bool res = true;
+		for (uint32_t k = 0; k < numKids; k++){
+			res = analyze(kids[k], symTab) && res;
+		}
+		symTab->leaveScope();
+		return res;
+	}
+	case FlatAST::VAR_DECL:
+	case FlatAST::FORMAL_DECL:
+		return analyzeVarDecl(node, symTab);
+	case FlatAST::FN_DECL:
+		return analyzeFnDecl(node, symTab);
+	case FlatAST::IF_STMT:
+	case FlatAST::WHILE_STMT: {
+		bool res = analyze(kids[0], symTab);
+		return analyzeBlock(kids + 1, numKids - 1, symTab) && res;
+	}
+	case FlatAST::IF_ELSE_STMT: {
+		uint32_t numTrue = ast->payload(node).count;
+		bool res = analyze(kids[0], symTab);
+		res = analyzeBlock(kids + 1, numTrue, symTab) && res;
+		return analyzeBlock(kids + 1 + numTrue, numKids - 1 - numTrue,
+			symTab) && res;
+	}
+	case FlatAST::ID: {
+		SemSymbol * sym = symTab->find(ast->name(node));
+		if (sym == nullptr){
+			return NameErr::undeclID(pos(node));
+		}
+		if (sym->getKind() != RECORD){ symbols[node] = sym; }
+		return true;
+	}
+	default: {
+		bool res = true;
+		for (uint32_t k = 0; k < numKids; k++){
+			res = analyze(kids[k], symTab) && res;
+		}
+		return res;
+	}
+	}
+}
+
+bool FlatNameAnalysis::analyzeBlock(const FlatAST::Index * stmts,
+	uint32_t count, SymbolTable * symTab){
+	symTab->enterScope();
+	bool res = true;
+	for (uint32_t k = 0; k < count; k++){
+		res = analyze(stmts[k], symTab) && res;
+	}
+	symTab->leaveScope();
+	return res;
+}
+
+bool FlatNameAnalysis::analyzeVarDecl(FlatAST::Index node,
+	SymbolTable * symTab){
+	FlatAST::Index id = ast->child(node, 1);
+	const DataType * dataType = flatTypeOf(ast, ast->child(node, 0));
+	Ident varName = ast->name(id);
+
+	bool validType = dataType->validVarType();
+	if (!validType){ NameErr::badVarType(pos(node)); }
+
+	bool validName = !symTab->clash(varName);
+	if (!validName){ NameErr::multiDecl(pos(id)); }
+
+	if (!validType || !validName){ return false; }
+	symTab->insert(new VarSymbol(varName, dataType));
+	return true;
+}
+
+bool FlatNameAnalysis::analyzeFnDecl(FlatAST::Index node,
+	SymbolTable * symTab){
+	const FlatAST::Index * kids = ast->children(node);
+	uint32_t numKids = ast->childCount(node);
+	uint32_t numFormals = ast->payload(node).count;
+	Ident fnName = ast->name(kids[1]);
+
+	ScopeTable atFnScope = symTab->getCurrentScope();
+	symTab->enterScope();
+
+	bool validName = true;
+	if (atFnScope.clash(fnName)){
+		NameErr::multiDecl(pos(kids[1]));
+		validName = false;
+	}
+
+	bool validFormals = true;
+	FnType::Formals formalTypes;
+	formalTypes.reserve(numFormals);
+	for (uint32_t k = 0; k < numFormals; k++){
+		FlatAST::Index formal = kids[2 + k];
+		validFormals = analyzeVarDecl(formal, symTab) && validFormals;
+		formalTypes.push_back(flatTypeOf(ast, ast->child(formal, 0)));
+	}
+
+	const DataType * retType = flatTypeOf(ast, kids[0]);
+	if (validName){
+		atFnScope.addFn(fnName, FnType::produce(retType, formalTypes));
+	}
+
+	bool validBody = true;
+	for (uint32_t k = 2 + numFormals; k < numKids; k++){
+		validBody = analyze(kids[k], symTab) && validBody;
+	}
+	symTab->leaveScope();
+	return validFormals && validName && validBody;
+}
+
+FlatTypeAnalysis::FlatTypeAnalysis(FlatNameAnalysis * names)
+: ast(names->ast), types(names->ast->size(), nullptr),
+  symbols(names->symbols),
+  reporter(new TypeAnalysis(static_cast<size_t>(0))){
+}
+
+FlatTypeAnalysis::~FlatTypeAnalysis(){
+	delete reporter;
+}
+
+FlatTypeAnalysis * FlatTypeAnalysis::build(FlatNameAnalysis * names){
+	FlatTypeAnalysis * types = new FlatTypeAnalysis(names);
+	types->check(types->ast->root());
+	if (!types->reporter->passed()){
+		delete types;
+		return nullptr;
+	}
+	return types;
+}
+
+const DataType * FlatTypeAnalysis::nodeType(FlatAST::Index node){
+	return reporter->checkType(types[node]);
+}
+
+void FlatTypeAnalysis::checkBlock(const FlatAST::Index * stmts,
+	uint32_t count){
+	for (uint32_t k = 0; k < count; k++){ check(stmts[k]); }
+}
+
+//Each case follows the typeAnalysis of the matching ASTNode
+// subclass, down to the order in which errors are reported
+void FlatTypeAnalysis::check(FlatAST::Index node){
+	const FlatAST::Index * kids = ast->children(node);
+	uint32_t numKids = ast->childCount(node);
+	switch (ast->kind(node)){
+	case FlatAST::PROGRAM:
+		checkBlock(kids, numKids);
+		nodeType(node, BasicType::VOID());
+		return;
+	case FlatAST::VAR_DECL:
+	case FlatAST::FORMAL_DECL:
+		nodeType(node, BasicType::VOID());
+		return;
+	case FlatAST::FN_DECL:
+		checkFnDecl(node);
+		return;
+	case FlatAST::ASSIGN_STMT: {
+		check(kids[0]);
+		const DataType * subType = nodeType(kids[0]);
+		nodeType(node, subType->asError() ? subType : BasicType::VOID());
+		return;
+	}
+	case FlatAST::READ_STMT: {
+		check(kids[0]);
+		const DataType * subType = nodeType(kids[0]);
+		if (subType->asFn()){
+			reporter->errAssignFn(pos(kids[0]));
+			nodeType(node, ErrorType::produce());
+		} else if (subType->isPtr()){
+			reporter->errReadPtr(pos(kids[0]));
+			nodeType(node, ErrorType::produce());
+		} else {
+			nodeType(node, BasicType::VOID());
+		}
+		return;
+	}
+	case FlatAST::WRITE_STMT: {
+		check(kids[0]);
+		const DataType * subType = nodeType(kids[0]);
+		if (subType->asFn()){
+			reporter->errWriteFn(pos(kids[0]));
+			nodeType(node, ErrorType::produce());
+		} else if (subType->isVoid()){
+			reporter->errWriteVoid(pos(kids[0]));
+			nodeType(node, ErrorType::produce());
+		} else if (subType->isPtr()){
+			reporter->errReadPtr(pos(kids[0]));
+			nodeType(node, ErrorType::produce());
+		} else {
+			nodeType(node, BasicType::VOID());
+		}
+		return;
+	}
+	case FlatAST::POST_INC_STMT:
+	case FlatAST::POST_DEC_STMT:
+		check(kids[0]);
+		if (!nodeType(kids[0])->isInt()){
+			reporter->errMathOpd(pos(kids[0]));
+		}
+		nodeType(node, BasicType::VOID());
+		return;
+	case FlatAST::IF_STMT:
+		checkCond(node, false);
+		checkBlock(kids + 1, numKids - 1);
+		nodeType(node, BasicType::VOID());
+		return;
+	case FlatAST::WHILE_STMT:
+		checkCond(node, true);
+		checkBlock(kids + 1, numKids - 1);
+		nodeType(node, BasicType::VOID());
+		return;
+	case FlatAST::IF_ELSE_STMT:
+		checkCond(node, false);
+		checkBlock(kids + 1, numKids - 1);
+		nodeType(node, BasicType::VOID());
+		return;
+	case FlatAST::RETURN_STMT:
+		checkReturn(node);
+		return;
+	case FlatAST::CALL_STMT:
+		check(kids[0]);
+		nodeType(node, BasicType::VOID());
+		return;
+	case FlatAST::CALL_EXP:
+		checkCall(node);
+		return;
+	case FlatAST::ASSIGN_EXP:
+		checkAssign(node);
+		return;
+	case FlatAST::PLUS: case FlatAST::MINUS:
+	case FlatAST::TIMES: case FlatAST::DIVIDE:
+		checkArith(node);
+		return;
+	case FlatAST::LESS: case FlatAST::LESS_EQ:
+	case FlatAST::GREATER: case FlatAST::GREATER_EQ:
+		checkRelation(node);
+		return;
+	case FlatAST::EQUALS: case FlatAST::NOT_EQUALS:
+		checkEquality(node);
+		return;
+	case FlatAST::AND: case FlatAST::OR:
+		checkLogic(node);
+		return;
+	case FlatAST::REF:
+		check(kids[0]);
+		nodeType(node, PtrType::produce(nodeType(kids[0])));
+		return;
+	case FlatAST::DEREF: {
+		check(kids[0]);
+		const DataType * type = nodeType(kids[0]);
+		if (type->asPtr()){
+			nodeType(node, type->asPtr()->getBase());
+		} else {
+			reporter->errDerefOpd(pos(kids[0]));
+			nodeType(node, ErrorType::produce());
+		}
+		return;
+	}
+	case FlatAST::NEG:
+	case FlatAST::NOT: {
+		check(kids[0]);
+		const DataType * subType = nodeType(kids[0]);
+		bool isNeg = ast->kind(node) == FlatAST::NEG;
+		bool valid = isNeg ? subType->isInt() : subType->isBool();
+		if (!valid && !subType->asError()){
+			if (isNeg){ reporter->errMathOpd(pos(kids[0])); }
+			else { reporter->errLogicOpd(pos(kids[0])); }
+			nodeType(node, ErrorType::produce());
+			return;
+		}
+		nodeType(node, subType);
+		return;
+	}
+	case FlatAST::ID:
+		nodeType(node, symbols[node]->getDataType());
+		return;
+	case FlatAST::INT_LIT:
+		nodeType(node, BasicType::INT());
+		return;
+	case FlatAST::SHORT_LIT:
+		nodeType(node, BasicType::SHORT());
+		return;
+	case FlatAST::STR_LIT:
+		nodeType(node, BasicType::STRING());
+		return;
+	case FlatAST::TRUE_LIT:
+	case FlatAST::FALSE_LIT:
+		nodeType(node, BasicType::BOOL());
+		return;
+	case FlatAST::VOID_TYPE: case FlatAST::INT_TYPE:
+	case FlatAST::SHORT_TYPE: case FlatAST::BOOL_TYPE:
+	case FlatAST::STRING_TYPE: case FlatAST::PTR_TYPE:
+	case FlatAST::NUM_KINDS:
+		throw new InternalError("Type nodes are not type checked");
+	}
+}
+
+void FlatTypeAnalysis::checkFnDecl(FlatAST::Index node){
+	const FlatAST::Index * kids = ast->children(node);
+	uint32_t numKids = ast->childCount(node);
+	uint32_t numFormals = ast->payload(node).count;
+	FnType::Formals formals;
+	formals.reserve(numFormals);
+	for (uint32_t k = 0; k < numFormals; k++){
+		formals.push_back(flatTypeOf(ast, ast->child(kids[2 + k], 0)));
+	}
+	const FnType * fnType = FnType::produce(flatTypeOf(ast, kids[0]),
+		formals);
+	nodeType(node, fnType);
+	reporter->setCurrentFnType(fnType);
+	checkBlock(kids + 2 + numFormals, numKids - 2 - numFormals);
+}
+
+//A function operand stands for its return type
+static bool intOperand(const DataType * type){
+	if (const FnType * fn = type->asFn()){
+		return fn->getReturnType()->isInt();
+	}
+	return type->isInt();
+}
+
+void FlatTypeAnalysis::checkArith(FlatAST::Index node){
+	FlatAST::Index lhs = ast->child(node, 0);
+	FlatAST::Index rhs = ast->child(node, 1);
+	check(lhs);
+	check(rhs);
+	if (!intOperand(nodeType(lhs))){ reporter->errMathOpd(pos(node)); }
+	if (!intOperand(nodeType(rhs))){ reporter->errMathOpd(pos(node)); }
+	nodeType(node, BasicType::INT());
+}
+
+void FlatTypeAnalysis::checkRelation(FlatAST::Index node){
+	FlatAST::Index lhs = ast->child(node, 0);
+	FlatAST::Index rhs = ast->child(node, 1);
+	check(lhs);
+	check(rhs);
+	if (!intOperand(nodeType(lhs))){ reporter->errRelOpd(pos(lhs)); }
+	if (!intOperand(nodeType(rhs))){ reporter->errRelOpd(pos(rhs)); }
+	nodeType(node, BasicType::BOOL());
+}
+
+void FlatTypeAnalysis::checkEquality(FlatAST::Index node){
+	bool valid[2];
+	for (uint32_t k = 0; k < 2; k++){
+		FlatAST::Index opd = ast->child(node, k);
+		check(opd);
+		const DataType * type = nodeType(opd);
+		valid[k] = type->isInt() || type->isBool();
+		if (!valid[k]){
+			reporter->errEqOpd(pos(opd));
+			nodeType(opd, ErrorType::produce());
+		}
+	}
+	if (valid[0] && valid[1]
+		&& nodeType(ast->child(node, 0)) != nodeType(ast->child(node, 1))){
+		reporter->errEqOpr(pos(node));
+		nodeType(node, ErrorType::produce());
+		return;
+	}
+	nodeType(node, BasicType::BOOL());
+}
+
+//As in AndNode and OrNode, a well-typed operation is given no
+// type, so that using its result fails
+void FlatTypeAnalysis::checkLogic(FlatAST::Index node){
+	FlatAST::Index lhs = ast->child(node, 0);
+	FlatAST::Index rhs = ast->child(node, 1);
+	check(lhs);
+	check(rhs);
+	const BasicType * left = nodeType(lhs)->asBasic();
+	const BasicType * right = nodeType(rhs)->asBasic();
+	if (left == nullptr || !left->isBool()
+		|| right == nullptr || !right->isBool()){
+		reporter->errLogicOpd(pos(node));
+		nodeType(node, ErrorType::produce());
+	}
+}
+
+void FlatTypeAnalysis::checkCall(FlatAST::Index node){
+	const FlatAST::Index * kids = ast->children(node);
+	uint32_t numArgs = ast->childCount(node) - 1;
+	for (uint32_t k = 0; k < numArgs; k++){ check(kids[1 + k]); }
+
+	const FnType * fnType = symbols[kids[0]]->getDataType()->asFn();
+	if (fnType == nullptr){
+		reporter->errCallee(pos(kids[0]));
+		nodeType(node, ErrorType::produce());
+		return;
+	}
+	const FnType::Formals& formals = fnType->getFormalTypes();
+	if (numArgs != formals.size()){
+		reporter->errArgCount(pos(kids[0]));
+	} else {
+		for (uint32_t k = 0; k < numArgs; k++){
+			const DataType * actualType = nodeType(kids[1 + k]);
+			const DataType * formalType = formals[k];
+			if (!actualType->asError() && !formalType->asError()
+				&& formalType != actualType){
+				reporter->errArgMatch(pos(node));
+			}
+		}
+	}
+	nodeType(node, fnType->getReturnType());
+}
+
+void FlatTypeAnalysis::checkAssign(FlatAST::Index node){
+	FlatAST::Index dst = ast->child(node, 0);
+	FlatAST::Index src = ast->child(node, 1);
+	check(dst);
+	check(src);
+	const DataType * tgtType = nodeType(dst);
+	const DataType * srcType = nodeType(src);
+	if (tgtType->asError() || srcType->asError()){
+		nodeType(node, ErrorType::produce());
+		return;
+	}
+	if (!tgtType->validVarType()){
+		reporter->errAssignOpd(pos(dst));
+		nodeType(node, ErrorType::produce());
+		return;
+	}
+	if (!srcType->validVarType()){
+		reporter->errAssignOpd(pos(src));
+		nodeType(node, ErrorType::produce());
+		return;
+	}
+	if (tgtType == srcType){
+		nodeType(node, tgtType);
+		return;
+	}
+	reporter->errAssignOpr(pos(node));
+	nodeType(node, ErrorType::produce());
+}
+
+void FlatTypeAnalysis::checkReturn(FlatAST::Index node){
+	const DataType * retType = reporter->getCurrentFnType()->getReturnType();
+	if (ast->childCount(node) == 0){
+		if (retType != BasicType::VOID()){
+			reporter->errRetEmpty(pos(node));
+			nodeType(node, ErrorType::produce());
+			return;
+		}
+		nodeType(node, BasicType::VOID());
+		return;
+	}
+	FlatAST::Index exp = ast->child(node, 0);
+	check(exp);
+	if (retType == BasicType::VOID()){
+		reporter->extraRetValue(pos(exp));
+		nodeType(node, ErrorType::produce());
+		return;
+	}
+	const DataType * subType = nodeType(exp);
+	if (subType != retType && !subType->asError()){
+		reporter->errRetWrong(pos(exp));
+		nodeType(node, ErrorType::produce());
+		return;
+	}
+	nodeType(node, BasicType::VOID());
+}
+
+void FlatTypeAnalysis::checkCond(FlatAST::Index node, bool isWhile){
+	FlatAST::Index cond = ast->child(node, 0);
+	check(cond);
+	const DataType * condType = nodeType(cond);
+	if (!condType->isBool() && !condType->asError()){
+		if (isWhile){ reporter->errWhileCond(pos(cond)); }
+		else { reporter->errIfCond(pos(cond)); }
+	}
+}
+
+}
@@ -0,0 +1,87 @@
+#ifndef CMINUSMINUS_FLAT_ANALYSIS_HPP
+#define CMINUSMINUS_FLAT_ANALYSIS_HPP
+
+#include <vector>
+#include "flat_ast.hpp"
+#include "symbol_table.hpp"
+#include "types.hpp"
+
+namespace cminusminus{
+
+class TypeAnalysis;
+
+//Name analysis over a FlatAST. It reports the same errors, in
+// the same order, as NameAnalysis does over the pointer AST;
+// the symbol each ID resolves to is kept in a column indexed
+// by node rather than in the IDs.
+class FlatNameAnalysis{
+public:
+	//Returns nullptr if any name fails to resolve
+	static FlatNameAnalysis * build(const FlatAST * astIn);
+
+	const FlatAST * ast;
+	std::vector<SemSymbol *> symbols;
+private:
+	FlatNameAnalysis(const FlatAST * astIn)
+	: ast(astIn), symbols(astIn->size(), nullptr){ }
+	bool analyze(FlatAST::Index node, SymbolTable * symTab);
+	bool analyzeVarDecl(FlatAST::Index node, SymbolTable * symTab);
+	bool analyzeFnDecl(FlatAST::Index node, SymbolTable * symTab);
+	bool analyzeBlock(const FlatAST::Index * stmts, uint32_t count,
+		SymbolTable * symTab);
+	//Where node is, for reporting an error there
+	const Position * pos(FlatAST::Index node){
+		at = ast->pos(node);
+		return &at;
+	}
+
+	Position at;
+};
+
+//The data type that a type node (INT_TYPE, PTR_TYPE, ...) names
+const DataType * flatTypeOf(const FlatAST * ast, FlatAST::Index node);
+
+//Type analysis over a FlatAST, with the same diagnostics as
+// TypeAnalysis. The type of each node is kept in a column
+// indexed by node.
+class FlatTypeAnalysis{
+public:
+	//Returns nullptr if the program does not type check
+	static FlatTypeAnalysis * build(FlatNameAnalysis * names);
+	~FlatTypeAnalysis();
+
+	const FlatAST * ast;
+	std::vector<const DataType *> types;
+private:
+	FlatTypeAnalysis(FlatNameAnalysis * names);
+	void check(FlatAST::Index node);
+	void checkFnDecl(FlatAST::Index node);
+	void checkArith(FlatAST::Index node);
+	void checkRelation(FlatAST::Index node);
+	void checkEquality(FlatAST::Index node);
+	void checkLogic(FlatAST::Index node);
+	void checkCall(FlatAST::Index node);
+	void checkAssign(FlatAST::Index node);
+	void checkReturn(FlatAST::Index node);
+	void checkCond(FlatAST::Index node, bool isWhile);
+	void checkBlock(const FlatAST::Index * stmts, uint32_t count);
+
+	void nodeType(FlatAST::Index node, const DataType * type){
+		types[node] = type;
+	}
+	const DataType * nodeType(FlatAST::Index node);
+	const Position * pos(FlatAST::Index node){
+		at = ast->pos(node);
+		return &at;
+	}
+
+	const std::vector<SemSymbol *>& symbols;
+	//Holds the error state and the current function, and
+	// reports the errors
+	TypeAnalysis * reporter;
+	Position at;
+};
+
+}
+
+#endif
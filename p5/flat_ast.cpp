@@ -0,0 +1,559 @@
+#include "flat_ast.hpp"
+#include "ast.hpp"
+#include "errors.hpp"
+#include "source_buffer.hpp"
+
+namespace cminusminus{
+
+FlatAST * FlatAST::build(ProgramNode * ast){
+	FlatAST * flat = new FlatAST();
+	Storage& store = flat->storage;
+	//Every node is a row, and every node but the root is the
+	// child of one other
+	size_t nodes = ast->nodeCount();
+	store.kinds.reserve(nodes);
+	store.firstChild.reserve(nodes);
+	store.counts.reserve(nodes);
+	store.starts.reserve(nodes);
+	store.ends.reserve(nodes);
+	store.payloads.reserve(nodes);
+	store.children.reserve(nodes);
+	ast->flatten(flat);
+	if (store.pending.size() != 1){
+		throw new InternalError("Flat AST is not a single tree");
+	}
+	flat->myRoot = store.pending.back();
+	store.pending.clear();
+	store.identIndex.clear();
+
+	flat->cols.kinds = store.kinds.data();
+	flat->cols.firstChild = store.firstChild.data();
+	flat->cols.counts = store.counts.data();
+	flat->cols.starts = store.starts.data();
+	flat->cols.ends = store.ends.data();
+	flat->cols.payloads = store.payloads.data();
+	flat->cols.children = store.children.data();
+	flat->numNodes = store.kinds.size();
+	flat->numChildren = store.children.size();
+	return flat;
+}
+
+FlatAST::~FlatAST(){
+	delete myLines;
+}
+
+void FlatAST::add(Kind kind, const Position& pos, uint32_t numChildren,
+	Payload payload){
+	std::vector<Index>& pending = storage.pending;
+	if (pending.size() < numChildren){
+		throw new InternalError("Flat AST node is missing children");
+	}
+	if (storage.kinds.size() >= UINT32_MAX){
+		throw new UserError("Program too large for a flat AST");
+	}
+	//The root's position may be empty, and so in no file
+	if (pos.file() != 0){ myFile = pos.file(); }
+	Index node = static_cast<Index>(storage.kinds.size());
+	storage.kinds.push_back(kind);
+	storage.firstChild.push_back(
+		static_cast<uint32_t>(storage.children.size()));
+	storage.counts.push_back(numChildren);
+	storage.starts.push_back(pos.startOffset());
+	storage.ends.push_back(pos.endOffset());
+	storage.payloads.push_back(payload);
+	auto first = pending.end() - numChildren;
+	storage.children.insert(storage.children.end(), first, pending.end());
+	pending.erase(first, pending.end());
+	pending.push_back(node);
+}
+
+void FlatAST::addID(const Position& pos, Ident name){
+	auto found = storage.identIndex.find(name);
+	Payload payload;
+	if (found != storage.identIndex.end()){
+		payload.count = found->second;
+	} else {
+		payload.count = static_cast<uint32_t>(idents.size());
+		storage.identIndex.emplace(name, payload.count);
+		idents.push_back(name);
+	}
+	add(ID, pos, 0, payload);
+}
+
+void FlatAST::addStrLit(const Position& pos, const char * text,
+	size_t len){
+	Payload payload;
+	payload.count = static_cast<uint32_t>(strings.size());
+	strings.push_back(Text{text, len});
+	add(STR_LIT, pos, 0, payload);
+}
+
+//A loaded table shares the bytes of its file, so only what
+// was built here is counted
+size_t FlatAST::bytes() const{
+	size_t rows = storage.kinds.capacity() * sizeof(Kind)
+		+ storage.firstChild.capacity() * sizeof(uint32_t)
+		+ storage.counts.capacity() * sizeof(uint32_t)
+		+ storage.starts.capacity() * sizeof(uint32_t)
+		+ storage.ends.capacity() * sizeof(uint32_t)
+		+ storage.payloads.capacity() * sizeof(Payload)
+		+ storage.children.capacity() * sizeof(Index);
+	if (myLines != nullptr){
+		//A loaded table's columns are in the mapped file
+		rows = numNodes * (sizeof(Kind) + 4 * sizeof(uint32_t)
+			+ sizeof(Payload)) + numChildren * sizeof(Index);
+	}
+	return rows + idents.capacity() * sizeof(Ident)
+		+ strings.capacity() * sizeof(Text);
+}
+
+static void doIndent(std::ostream& out, int indent){
+	for (int k = 0 ; k < indent; k++){ out << "\t"; }
+}
+
+static const char * binaryOp(FlatAST::Kind kind){
+	switch (kind){
+	case FlatAST::PLUS: return " + ";
+	case FlatAST::MINUS: return " - ";
+	case FlatAST::TIMES: return " * ";
+	case FlatAST::DIVIDE: return " / ";
+	case FlatAST::AND: return " and ";
+	case FlatAST::OR: return " or ";
+	case FlatAST::EQUALS: return " == ";
+	case FlatAST::NOT_EQUALS: return " != ";
+	case FlatAST::LESS: return " < ";
+	case FlatAST::LESS_EQ: return " <= ";
+	case FlatAST::GREATER: return " > ";
+	case FlatAST::GREATER_EQ: return " >= ";
+	default: return nullptr;
+	}
+}
+
+void FlatAST::unparse(std::ostream& out,
+	const std::vector<SemSymbol *> * symbols) const{
+	unparseNode(out, myRoot, 0, symbols);
+}
+
+void FlatAST::unparseStmts(std::ostream& out, const Index * stmts,
+	uint32_t count, int indent,
+	const std::vector<SemSymbol *> * symbols) const{
+	for (uint32_t k = 0; k < count; k++){
+		unparseNode(out, stmts[k], indent, symbols);
+	}
+}
+
+//Operands are parenthesized, as in ExpNode::unparseNested,
+// unless they are lvalues, literals or calls
+void FlatAST::unparseNested(std::ostream& out, Index node,
+	const std::vector<SemSymbol *> * symbols) const{
+	switch (kind(node)){
+	case ID: case DEREF: case CALL_EXP:
+	case INT_LIT: case SHORT_LIT: case STR_LIT:
+	case TRUE_LIT: case FALSE_LIT:
+		unparseNode(out, node, 0, symbols);
+		return;
+	default:
+		out << "(";
+		unparseNode(out, node, 0, symbols);
+		out << ")";
+	}
+}
+
+void FlatAST::unparseNode(std::ostream& out, Index node, int indent,
+	const std::vector<SemSymbol *> * symbols) const{
+	const Index * kids = children(node);
+	uint32_t numKids = childCount(node);
+	Kind nodeKind = kind(node);
+	if (nodeKind == PROGRAM){
+		unparseStmts(out, kids, numKids, indent, symbols);
+		return;
+	}
+	doIndent(out, indent);
+	switch (nodeKind){
+	case PROGRAM:
+		break;
+	case VAR_DECL:
+		unparseNode(out, kids[0], 0, symbols);
+		out << " ";
+		unparseNode(out, kids[1], 0, symbols);
+		out << ";\n";
+		break;
+	case FORMAL_DECL:
+		unparseNode(out, kids[0], 0, symbols);
+		out << " ";
+		unparseNode(out, kids[1], 0, symbols);
+		break;
+	case FN_DECL: {
+		uint32_t numFormals = payload(node).count;
+		unparseNode(out, kids[0], 0, symbols);
+		out << " ";
+		unparseNode(out, kids[1], 0, symbols);
+		out << "(";
+		for (uint32_t k = 0; k < numFormals; k++){
+			if (k > 0){ out << ", "; }
+			unparseNode(out, kids[2 + k], 0, symbols);
+		}
+		out << "){\n";
+		unparseStmts(out, kids + 2 + numFormals,
+			numKids - 2 - numFormals, indent + 1, symbols);
+		doIndent(out, indent);
+		out << "}\n";
+		break;
+	}
+	case ASSIGN_STMT:
+	case CALL_STMT:
+		unparseNode(out, kids[0], 0, symbols);
+		out << ";\n";
+		break;
+	case READ_STMT:
+		out << "read ";
+		unparseNode(out, kids[0], 0, symbols);
+		out << ";\n";
+		break;
+	case WRITE_STMT:
+		out << "write ";
+		unparseNode(out, kids[0], 0, symbols);
+		out << ";\n";
+		break;
+	case POST_INC_STMT:
+		unparseNode(out, kids[0], 0, symbols);
+		out << "++;\n";
+		break;
+	case POST_DEC_STMT:
+		unparseNode(out, kids[0], 0, symbols);
+		out << "--;\n";
+		break;
+	case IF_STMT:
+	case WHILE_STMT:
+		out << (nodeKind == IF_STMT ? "if (" : "while (");
+		unparseNode(out, kids[0], 0, symbols);
+		out << "){\n";
+		unparseStmts(out, kids + 1, numKids - 1, indent + 1, symbols);
+		doIndent(out, indent);
+		out << "}\n";
+		break;
+	case IF_ELSE_STMT: {
+		uint32_t numTrue = payload(node).count;
+		out << "if (";
+		unparseNode(out, kids[0], 0, symbols);
+		out << "){\n";
+		unparseStmts(out, kids + 1, numTrue, indent + 1, symbols);
+		doIndent(out, indent);
+		out << "} else {\n";
+		unparseStmts(out, kids + 1 + numTrue, numKids - 1 - numTrue,
+			indent + 1, symbols);
+		doIndent(out, indent);
+		out << "}\n";
+		break;
+	}
+	case RETURN_STMT:
+		out << "return";
+		if (numKids > 0){
+			out << " ";
+			unparseNode(out, kids[0], 0, symbols);
+		}
+		out << ";\n";
+		break;
+	case CALL_EXP:
+		unparseNode(out, kids[0], 0, symbols);
+		out << "(";
+		for (uint32_t k = 1; k < numKids; k++){
+			if (k > 1){ out << ", "; }
+			unparseNode(out, kids[k], 0, symbols);
+		}
+		out << ")";
+		break;
+	case ASSIGN_EXP:
+		unparseNested(out, kids[0], symbols);
+		out << " = ";
+		unparseNested(out, kids[1], symbols);
+		break;
+	case PLUS: case MINUS: case TIMES: case DIVIDE:
+	case AND: case OR: case EQUALS: case NOT_EQUALS:
+	case LESS: case LESS_EQ: case GREATER: case GREATER_EQ:
+		unparseNested(out, kids[0], symbols);
+		out << binaryOp(nodeKind);
+		unparseNested(out, kids[1], symbols);
+		break;
+	case REF:
+		out << "& ";
+		unparseNested(out, kids[0], symbols);
+		break;
+	case DEREF:
+		out << "@ ";
+		unparseNested(out, kids[0], symbols);
+		break;
+	case NEG:
+		out << "-";
+		unparseNested(out, kids[0], symbols);
+		break;
+	case NOT:
+		out << "!";
+		unparseNested(out, kids[0], symbols);
+		break;
+	case ID: {
+		out << *name(node);
+		SemSymbol * sym = nullptr;
+		if (symbols != nullptr && node < symbols->size()){
+			sym = (*symbols)[node];
+		}
+		if (sym != nullptr){
+			out << "(" << sym->getDataType()->getString() << ")";
+		}
+		break;
+	}
+	case INT_LIT:
+		out << payload(node).num;
+		break;
+	case SHORT_LIT:
+		out << payload(node).num << "S";
+		break;
+	case STR_LIT:
+		out.write(text(node), static_cast<std::streamsize>(textLength(node)));
+		break;
+	case TRUE_LIT:
+		out << "true";
+		break;
+	case FALSE_LIT:
+		out << "false";
+		break;
+	case VOID_TYPE:
+		out << "void";
+		break;
+	case INT_TYPE:
+		out << "int";
+		break;
+	case SHORT_TYPE:
+		out << "short";
+		break;
+	case BOOL_TYPE:
+		out << "bool";
+		break;
+	case STRING_TYPE:
+		out << "string";
+		break;
+	case PTR_TYPE:
+		out << "ptr ";
+		unparseNode(out, kids[0], 0, symbols);
+		break;
+	case NUM_KINDS:
+		break;
+	}
+}
+
+//Each node appends its children, then itself
+
+static FlatAST::Payload countPayload(size_t count){
+	FlatAST::Payload payload;
+	payload.count = static_cast<uint32_t>(count);
+	return payload;
+}
+
+static FlatAST::Payload numPayload(int num){
+	FlatAST::Payload payload;
+	payload.num = num;
+	return payload;
+}
+
+template <typename T>
+static uint32_t flattenAll(FlatAST * flat, NodeList<T> * list){
+	for (T node : *list){ node->flatten(flat); }
+	return static_cast<uint32_t>(list->size());
+}
+
+void ProgramNode::flatten(FlatAST * flat){
+	uint32_t globals = flattenAll(flat, myGlobals);
+	flat->add(FlatAST::PROGRAM, myPos, globals);
+}
+
+void VarDeclNode::flatten(FlatAST * flat){
+	myType->flatten(flat);
+	myID->flatten(flat);
+	flat->add(FlatAST::VAR_DECL, myPos, 2);
+}
+
+void FormalDeclNode::flatten(FlatAST * flat){
+	getTypeNode()->flatten(flat);
+	ID()->flatten(flat);
+	flat->add(FlatAST::FORMAL_DECL, myPos, 2);
+}
+
+void FnDeclNode::flatten(FlatAST * flat){
+	myRetType->flatten(flat);
+	myID->flatten(flat);
+	uint32_t formals = flattenAll(flat, myFormals);
+	uint32_t stmts = flattenAll(flat, myBody);
+	flat->add(FlatAST::FN_DECL, myPos, 2 + formals + stmts,
+		countPayload(formals));
+}
+
+void AssignStmtNode::flatten(FlatAST * flat){
+	myExp->flatten(flat);
+	flat->add(FlatAST::ASSIGN_STMT, myPos, 1);
+}
+
+void ReadStmtNode::flatten(FlatAST * flat){
+	myDst->flatten(flat);
+	flat->add(FlatAST::READ_STMT, myPos, 1);
+}
+
+void WriteStmtNode::flatten(FlatAST * flat){
+	mySrc->flatten(flat);
+	flat->add(FlatAST::WRITE_STMT, myPos, 1);
+}
+
+void PostIncStmtNode::flatten(FlatAST * flat){
+	myLVal->flatten(flat);
+	flat->add(FlatAST::POST_INC_STMT, myPos, 1);
+}
+
+void PostDecStmtNode::flatten(FlatAST * flat){
+	myLVal->flatten(flat);
+	flat->add(FlatAST::POST_DEC_STMT, myPos, 1);
+}
+
+void IfStmtNode::flatten(FlatAST * flat){
+	myCond->flatten(flat);
+	uint32_t stmts = flattenAll(flat, myBody);
+	flat->add(FlatAST::IF_STMT, myPos, 1 + stmts);
+}
+
+void IfElseStmtNode::flatten(FlatAST * flat){
+	myCond->flatten(flat);
+	uint32_t trueStmts = flattenAll(flat, myBodyTrue);
+	uint32_t falseStmts = flattenAll(flat, myBodyFalse);
+	flat->add(FlatAST::IF_ELSE_STMT, myPos, 1 + trueStmts + falseStmts,
+		countPayload(trueStmts));
+}
+
+void WhileStmtNode::flatten(FlatAST * flat){
+	myCond->flatten(flat);
+	uint32_t stmts = flattenAll(flat, myBody);
+	flat->add(FlatAST::WHILE_STMT, myPos, 1 + stmts);
+}
+
+void ReturnStmtNode::flatten(FlatAST * flat){
+	if (myExp == nullptr){
+		flat->add(FlatAST::RETURN_STMT, myPos, 0);
+		return;
+	}
+	myExp->flatten(flat);
+	flat->add(FlatAST::RETURN_STMT, myPos, 1);
+}
+
+void CallStmtNode::flatten(FlatAST * flat){
+	myCallExp->flatten(flat);
+	flat->add(FlatAST::CALL_STMT, myPos, 1);
+}
+
+void CallExpNode::flatten(FlatAST * flat){
+	myID->flatten(flat);
+	uint32_t args = flattenAll(flat, myArgs);
+	flat->add(FlatAST::CALL_EXP, myPos, 1 + args);
+}
+
+void AssignExpNode::flatten(FlatAST * flat){
+	myDst->flatten(flat);
+	mySrc->flatten(flat);
+	flat->add(FlatAST::ASSIGN_EXP, myPos, 2);
+}
+
+void BinaryExpNode::flattenAs(FlatAST * flat, FlatAST::Kind kind){
+	myExp1->flatten(flat);
+	myExp2->flatten(flat);
+	flat->add(kind, myPos, 2);
+}
+
+void PlusNode::flatten(FlatAST * flat){ flattenAs(flat, FlatAST::PLUS); }
+void MinusNode::flatten(FlatAST * flat){ flattenAs(flat, FlatAST::MINUS); }
+void TimesNode::flatten(FlatAST * flat){ flattenAs(flat, FlatAST::TIMES); }
+void DivideNode::flatten(FlatAST * flat){ flattenAs(flat, FlatAST::DIVIDE); }
+void AndNode::flatten(FlatAST * flat){ flattenAs(flat, FlatAST::AND); }
+void OrNode::flatten(FlatAST * flat){ flattenAs(flat, FlatAST::OR); }
+void EqualsNode::flatten(FlatAST * flat){
+	flattenAs(flat, FlatAST::EQUALS);
+}
+void NotEqualsNode::flatten(FlatAST * flat){
+	flattenAs(flat, FlatAST::NOT_EQUALS);
+}
+void LessNode::flatten(FlatAST * flat){ flattenAs(flat, FlatAST::LESS); }
+void LessEqNode::flatten(FlatAST * flat){
+	flattenAs(flat, FlatAST::LESS_EQ);
+}
+void GreaterNode::flatten(FlatAST * flat){
+	flattenAs(flat, FlatAST::GREATER);
+}
+void GreaterEqNode::flatten(FlatAST * flat){
+	flattenAs(flat, FlatAST::GREATER_EQ);
+}
+
+void RefNode::flatten(FlatAST * flat){
+	myID->flatten(flat);
+	flat->add(FlatAST::REF, myPos, 1);
+}
+
+void DerefNode::flatten(FlatAST * flat){
+	myID->flatten(flat);
+	flat->add(FlatAST::DEREF, myPos, 1);
+}
+
+void NegNode::flatten(FlatAST * flat){
+	myExp->flatten(flat);
+	flat->add(FlatAST::NEG, myPos, 1);
+}
+
+void NotNode::flatten(FlatAST * flat){
+	myExp->flatten(flat);
+	flat->add(FlatAST::NOT, myPos, 1);
+}
+
+void IDNode::flatten(FlatAST * flat){
+	flat->addID(myPos, name);
+}
+
+void IntLitNode::flatten(FlatAST * flat){
+	flat->add(FlatAST::INT_LIT, myPos, 0, numPayload(myNum));
+}
+
+void ShortLitNode::flatten(FlatAST * flat){
+	flat->add(FlatAST::SHORT_LIT, myPos, 0, numPayload(myNum));
+}
+
+void StrLitNode::flatten(FlatAST * flat){
+	flat->addStrLit(myPos, myText, myLen);
+}
+
+void TrueNode::flatten(FlatAST * flat){
+	flat->add(FlatAST::TRUE_LIT, myPos, 0);
+}
+
+void FalseNode::flatten(FlatAST * flat){
+	flat->add(FlatAST::FALSE_LIT, myPos, 0);
+}
+
+void VoidTypeNode::flatten(FlatAST * flat){
+	flat->add(FlatAST::VOID_TYPE, myPos, 0);
+}
+
+void IntTypeNode::flatten(FlatAST * flat){
+	flat->add(FlatAST::INT_TYPE, myPos, 0);
+}
+
+void ShortTypeNode::flatten(FlatAST * flat){
+	flat->add(FlatAST::SHORT_TYPE, myPos, 0);
+}
+
+void BoolTypeNode::flatten(FlatAST * flat){
+	flat->add(FlatAST::BOOL_TYPE, myPos, 0);
+}
+
+void StringTypeNode::flatten(FlatAST * flat){
+	flat->add(FlatAST::STRING_TYPE, myPos, 0);
+}
+
+void PtrTypeNode::flatten(FlatAST * flat){
+	myBaseType->flatten(flat);
+	flat->add(FlatAST::PTR_TYPE, myPos, 1);
+}
+
+}
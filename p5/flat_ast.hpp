@@ -0,0 +1,180 @@
+#ifndef CMINUSMINUS_FLAT_AST_HPP
+#define CMINUSMINUS_FLAT_AST_HPP
+
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+#include "interner.hpp"
+#include "position.hpp"
+
+namespace cminusminus{
+
+class ProgramNode;
+class SemSymbol;
+class SourceBuffer;
+
+//The AST laid out as a table rather than as a graph of objects.
+// Each node is a row, and each field of the nodes is a column
+// held in its own array: the kind, where the node's children
+// start in the shared child array and how many there are, the
+// start and end of its position, and a payload (the value of a
+// literal, an index into the tables of names and string
+// literals, or the size of a list). Nodes are referred to by
+// 32-bit index, children always coming before their parents.
+//
+//The table is filled in by lowering the pointer AST once it
+// has been parsed (see ASTNode::flatten), or is loaded from a
+// file written by save. Unparsing and both semantic analyses
+// have implementations over it (see flat_analysis.hpp), so
+// that the two layouts can be compared.
+class FlatAST{
+public:
+	using Index = uint32_t;
+
+	enum Kind : uint8_t{
+		PROGRAM, VAR_DECL, FORMAL_DECL, FN_DECL,
+		ASSIGN_STMT, READ_STMT, WRITE_STMT, POST_INC_STMT,
+		POST_DEC_STMT, IF_STMT, IF_ELSE_STMT, WHILE_STMT,
+		RETURN_STMT, CALL_STMT,
+		CALL_EXP, ASSIGN_EXP,
+		PLUS, MINUS, TIMES, DIVIDE, AND, OR, EQUALS, NOT_EQUALS,
+		LESS, LESS_EQ, GREATER, GREATER_EQ,
+		REF, DEREF, NEG, NOT,
+		ID, INT_LIT, SHORT_LIT, STR_LIT, TRUE_LIT, FALSE_LIT,
+		VOID_TYPE, INT_TYPE, SHORT_TYPE, BOOL_TYPE, STRING_TYPE,
+		PTR_TYPE,
+		NUM_KINDS
+	};
+
+	//What a node carries besides its children. For a function
+	// declaration it is the number of formals, and for an
+	// if-else the number of statements in the true branch. An
+	// ID or a string literal holds the index of its text.
+	union Payload{
+		int num;
+		uint32_t count;
+	};
+
+	FlatAST(){ }
+	FlatAST(const FlatAST&) = delete;
+	FlatAST& operator=(const FlatAST&) = delete;
+	~FlatAST();
+
+	//Lower the tree rooted at ast into a new table
+	static FlatAST * build(ProgramNode * ast);
+
+	//Write the table to a file that load can map back in. The
+	// file holds the line index of the source, so that
+	// positions still print, but not the source itself.
+	void save(std::ostream& out) const;
+	//Whether the bytes of file were written by save
+	static bool isSaved(const SourceBuffer * file);
+	//Use a saved table in place. The table refers into file,
+	// which must outlive it. Throws a UserError if the file is
+	// damaged or from another version of the format.
+	static FlatAST * load(const SourceBuffer * file);
+
+	//Append a node whose children are the last numChildren
+	// nodes added that do not have a parent yet
+	void add(Kind kind, const Position& pos, uint32_t numChildren,
+		Payload payload);
+	void add(Kind kind, const Position& pos, uint32_t numChildren){
+		Payload none;
+		none.count = 0;
+		add(kind, pos, numChildren, none);
+	}
+	void addID(const Position& pos, Ident name);
+	void addStrLit(const Position& pos, const char * text, size_t len);
+
+	Index root() const { return myRoot; }
+	size_t size() const { return numNodes; }
+	Kind kind(Index node) const { return cols.kinds[node]; }
+	uint32_t childCount(Index node) const { return cols.counts[node]; }
+	//The children of node, in source order
+	const Index * children(Index node) const {
+		return cols.children + cols.firstChild[node];
+	}
+	Index child(Index node, uint32_t k) const {
+		return cols.children[cols.firstChild[node] + k];
+	}
+	Position pos(Index node) const {
+		return Position(myFile, cols.starts[node], cols.ends[node]);
+	}
+	Payload payload(Index node) const { return cols.payloads[node]; }
+	Ident name(Index node) const {
+		return idents[cols.payloads[node].count];
+	}
+	const char * text(Index node) const {
+		return strings[cols.payloads[node].count].text;
+	}
+	size_t textLength(Index node) const {
+		return strings[cols.payloads[node].count].len;
+	}
+
+	//The bytes held by the table
+	size_t bytes() const;
+
+	//Write the program in canonical form. Given the symbols
+	// found by a name analysis (indexed by node), IDs are
+	// annotated with their types.
+	void unparse(std::ostream& out,
+		const std::vector<SemSymbol *> * symbols = nullptr) const;
+private:
+	struct Text{
+		const char * text;
+		size_t len;
+	};
+	//The columns. They point into the vectors below for a
+	// table built here, and into the mapped file for one that
+	// was loaded.
+	struct Columns{
+		const Kind * kinds;
+		const uint32_t * firstChild;
+		const uint32_t * counts;
+		const uint32_t * starts;
+		const uint32_t * ends;
+		const Payload * payloads;
+		const Index * children;
+	};
+	//The storage of a table being built
+	struct Storage{
+		std::vector<Kind> kinds;
+		std::vector<uint32_t> firstChild;
+		std::vector<uint32_t> counts;
+		std::vector<uint32_t> starts;
+		std::vector<uint32_t> ends;
+		std::vector<Payload> payloads;
+		std::vector<Index> children;
+		std::unordered_map<Ident, uint32_t> identIndex;
+		//Nodes built but not yet given a parent
+		std::vector<Index> pending;
+	};
+
+	void checkShape() const;
+	void unparseNode(std::ostream& out, Index node, int indent,
+		const std::vector<SemSymbol *> * symbols) const;
+	void unparseNested(std::ostream& out, Index node,
+		const std::vector<SemSymbol *> * symbols) const;
+	void unparseStmts(std::ostream& out, const Index * stmts,
+		uint32_t count, int indent,
+		const std::vector<SemSymbol *> * symbols) const;
+
+	Columns cols = Columns();
+	size_t numNodes = 0;
+	size_t numChildren = 0;
+	Storage storage;
+	std::vector<Ident> idents;
+	//The text of string literals, which points into the source
+	// (or into the saved file)
+	std::vector<Text> strings;
+	Index myRoot = 0;
+	//The file that every position is in
+	uint32_t myFile = 0;
+	//For a loaded table, the line index of its source
+	SourceBuffer * myLines = nullptr;
+};
+
+}
+
+#endif
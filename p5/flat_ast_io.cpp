@@ -0,0 +1,292 @@
+#include <cstring>
+#include "flat_ast.hpp"
+#include "errors.hpp"
+#include "source_buffer.hpp"
+
+namespace cminusminus{
+
+//A saved table is a header followed by the sections below, in
+// this order. Each section starts on a 4-byte boundary, so the
+// columns can be used straight out of the mapped file.
+//
+//  kinds       one byte per node
+//  firstChild, counts, starts, ends, payloads
+//              one 32-bit word per node each
+//  children    one word per child
+//  lines       the offset of each line of the source
+//  idents, strings
+//              an (offset, length) pair of words per entry,
+//              locating its text in the text section
+//  text        the spellings of the names and string literals
+//
+//Words are in the byte order of the machine that wrote them,
+// which the header records; a file from a machine of the other
+// order is rejected rather than converted.
+static const char MAGIC[8] = { 'C', 'M', 'M', 'A', 'S', 'T', '\r', '\n' };
+//Bump whenever the layout or the meaning of a kind changes
+static const uint32_t FORMAT_VERSION = 1;
+static const uint32_t ORDER_MARK = 0x01020304;
+
+struct SavedHeader{
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint32_t nodes;
+	uint32_t children;
+	uint32_t lines;
+	uint32_t idents;
+	uint32_t strings;
+	uint32_t textBytes;
+	uint32_t root;
+	uint32_t reserved;
+};
+
+struct TextRef{
+	uint32_t offset;
+	uint32_t len;
+};
+
+static_assert(sizeof(FlatAST::Kind) == 1, "kinds are saved as bytes");
+static_assert(sizeof(FlatAST::Payload) == 4, "payloads are saved as words");
+static_assert(sizeof(SavedHeader) % 4 == 0, "sections follow the header");
+
+static size_t padded(size_t bytes){
+	return (bytes + 3) & ~static_cast<size_t>(3);
+}
+
+template <typename T>
+static void writeArray(std::ostream& out, const T * data, size_t count){
+	out.write(reinterpret_cast<const char *>(data),
+		static_cast<std::streamsize>(count * sizeof(T)));
+}
+
+void FlatAST::save(std::ostream& out) const{
+	std::vector<uint32_t> lines;
+	SourceBuffer * source = SourceBuffer::lookup(myFile);
+	if (source != nullptr){ lines = source->lineStarts(); }
+
+	std::string text;
+	std::vector<TextRef> identRefs;
+	for (Ident name : idents){
+		identRefs.push_back(TextRef{static_cast<uint32_t>(text.size()),
+			static_cast<uint32_t>(name->size())});
+		text += *name;
+	}
+	std::vector<TextRef> stringRefs;
+	for (const Text& str : strings){
+		stringRefs.push_back(TextRef{static_cast<uint32_t>(text.size()),
+			static_cast<uint32_t>(str.len)});
+		text.append(str.text, str.len);
+	}
+	if (text.size() > UINT32_MAX){
+		throw new UserError("Program too large to save");
+	}
+
+	SavedHeader header;
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = FORMAT_VERSION;
+	header.byteOrder = ORDER_MARK;
+	header.nodes = static_cast<uint32_t>(numNodes);
+	header.children = static_cast<uint32_t>(numChildren);
+	header.lines = static_cast<uint32_t>(lines.size());
+	header.idents = static_cast<uint32_t>(identRefs.size());
+	header.strings = static_cast<uint32_t>(stringRefs.size());
+	header.textBytes = static_cast<uint32_t>(text.size());
+	header.root = myRoot;
+	header.reserved = 0;
+
+	writeArray(out, &header, 1);
+	writeArray(out, cols.kinds, numNodes);
+	const char pad[4] = { 0, 0, 0, 0 };
+	size_t padding = padded(numNodes) - numNodes;
+	out.write(pad, static_cast<std::streamsize>(padding));
+	writeArray(out, cols.firstChild, numNodes);
+	writeArray(out, cols.counts, numNodes);
+	writeArray(out, cols.starts, numNodes);
+	writeArray(out, cols.ends, numNodes);
+	writeArray(out, cols.payloads, numNodes);
+	writeArray(out, cols.children, numChildren);
+	writeArray(out, lines.data(), lines.size());
+	writeArray(out, identRefs.data(), identRefs.size());
+	writeArray(out, stringRefs.data(), stringRefs.size());
+	out.write(text.data(), static_cast<std::streamsize>(text.size()));
+}
+
+bool FlatAST::isSaved(const SourceBuffer * file){
+	return file->size() >= sizeof(MAGIC)
+		&& memcmp(file->data(), MAGIC, sizeof(MAGIC)) == 0;
+}
+
+//Hands out the sections of a saved file in order, checking
+// that each one fits
+class SectionReader{
+public:
+	SectionReader(const SourceBuffer * fileIn)
+	: data(fileIn->data()), size(fileIn->size()){ }
+	template <typename T>
+	const T * next(size_t count){
+		size_t bytes = count * sizeof(T);
+		if (bytes / sizeof(T) != count || bytes > size - offset){
+			throw new UserError("Saved AST is truncated");
+		}
+		const T * section = reinterpret_cast<const T *>(data + offset);
+		offset = padded(offset + bytes);
+		if (offset > size){ offset = size; }
+		return section;
+	}
+private:
+	const char * data;
+	size_t size;
+	size_t offset = 0;
+};
+
+FlatAST * FlatAST::load(const SourceBuffer * file){
+	SectionReader reader(file);
+	const SavedHeader * header = reader.next<SavedHeader>(1);
+	if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0){
+		throw new UserError("Not a saved AST");
+	}
+	if (header->version != FORMAT_VERSION
+		|| header->byteOrder != ORDER_MARK){
+		throw new UserError("Saved AST is from another version of cmmc");
+	}
+
+	FlatAST * flat = new FlatAST();
+	try {
+		size_t nodes = header->nodes;
+		flat->numNodes = nodes;
+		flat->numChildren = header->children;
+		flat->myRoot = header->root;
+		flat->cols.kinds = reader.next<Kind>(nodes);
+		flat->cols.firstChild = reader.next<uint32_t>(nodes);
+		flat->cols.counts = reader.next<uint32_t>(nodes);
+		flat->cols.starts = reader.next<uint32_t>(nodes);
+		flat->cols.ends = reader.next<uint32_t>(nodes);
+		flat->cols.payloads = reader.next<Payload>(nodes);
+		flat->cols.children = reader.next<Index>(header->children);
+		const uint32_t * lines = reader.next<uint32_t>(header->lines);
+		const TextRef * identRefs = reader.next<TextRef>(header->idents);
+		const TextRef * stringRefs = reader.next<TextRef>(header->strings);
+		const char * text = reader.next<char>(header->textBytes);
+
+		for (uint32_t k = 0; k < header->lines; k++){
+			if (k == 0 ? lines[k] != 0 : lines[k] <= lines[k - 1]){
+				throw new UserError("Saved AST has a bad line index");
+			}
+		}
+		auto checkRef = [header](const TextRef& ref){
+			if (ref.offset > header->textBytes
+				|| ref.len > header->textBytes - ref.offset){
+				throw new UserError("Saved AST has a bad text reference");
+			}
+		};
+		flat->idents.reserve(header->idents);
+		for (uint32_t k = 0; k < header->idents; k++){
+			checkRef(identRefs[k]);
+			flat->idents.push_back(Interner::intern(
+				text + identRefs[k].offset, identRefs[k].len));
+		}
+		flat->strings.reserve(header->strings);
+		for (uint32_t k = 0; k < header->strings; k++){
+			checkRef(stringRefs[k]);
+			flat->strings.push_back(Text{text + stringRefs[k].offset,
+				stringRefs[k].len});
+		}
+		flat->checkShape();
+
+		flat->myLines = SourceBuffer::fromLines(
+			std::vector<uint32_t>(lines, lines + header->lines));
+		flat->myFile = flat->myLines->id();
+	} catch (...) {
+		delete flat;
+		throw;
+	}
+	return flat;
+}
+
+//The passes trust the shape of the tree, so a loaded one is
+// checked first: every child comes before its parent (so there
+// are no cycles), and each kind has the children it should.
+void FlatAST::checkShape() const{
+	auto bad = []{ throw new UserError("Saved AST is damaged"); };
+	if (numNodes == 0 || myRoot != numNodes - 1){ bad(); }
+	auto isType = [this](Index node){
+		Kind k = kind(node);
+		return k >= VOID_TYPE && k <= PTR_TYPE;
+	};
+	for (Index node = 0; node < numNodes; node++){
+		uint32_t count = cols.counts[node];
+		uint32_t first = cols.firstChild[node];
+		if (first > numChildren || count > numChildren - first){ bad(); }
+		const Index * kids = cols.children + first;
+		for (uint32_t k = 0; k < count; k++){
+			if (kids[k] >= node){ bad(); }
+		}
+		uint32_t extra = cols.payloads[node].count;
+		bool ok;
+		switch (kind(node)){
+		case PROGRAM:
+			//Only declarations are outside every function
+			ok = node == myRoot;
+			for (uint32_t k = 0; ok && k < count; k++){
+				ok = kind(kids[k]) == VAR_DECL || kind(kids[k]) == FN_DECL;
+			}
+			break;
+		case VAR_DECL: case FORMAL_DECL:
+			ok = count == 2 && isType(kids[0]) && kind(kids[1]) == ID;
+			break;
+		case FN_DECL:
+			ok = count >= 2 && extra <= count - 2 && isType(kids[0])
+				&& kind(kids[1]) == ID;
+			for (uint32_t k = 0; ok && k < extra; k++){
+				ok = kind(kids[2 + k]) == FORMAL_DECL;
+			}
+			break;
+		case IF_STMT: case WHILE_STMT:
+			ok = count >= 1;
+			break;
+		case IF_ELSE_STMT:
+			ok = count >= 1 && extra <= count - 1;
+			break;
+		case RETURN_STMT:
+			ok = count <= 1;
+			break;
+		case CALL_EXP:
+			ok = count >= 1 && kind(kids[0]) == ID;
+			break;
+		case REF: case DEREF:
+			ok = count == 1 && kind(kids[0]) == ID;
+			break;
+		case ASSIGN_STMT: case READ_STMT: case WRITE_STMT:
+		case POST_INC_STMT: case POST_DEC_STMT: case CALL_STMT:
+		case NEG: case NOT:
+			ok = count == 1;
+			break;
+		case ASSIGN_EXP:
+		case PLUS: case MINUS: case TIMES: case DIVIDE:
+		case AND: case OR: case EQUALS: case NOT_EQUALS:
+		case LESS: case LESS_EQ: case GREATER: case GREATER_EQ:
+			ok = count == 2;
+			break;
+		case ID:
+			ok = count == 0 && extra < idents.size();
+			break;
+		case STR_LIT:
+			ok = count == 0 && extra < strings.size();
+			break;
+		case PTR_TYPE:
+			ok = count == 1 && isType(kids[0]);
+			break;
+		case INT_LIT: case SHORT_LIT: case TRUE_LIT: case FALSE_LIT:
+		case VOID_TYPE: case INT_TYPE: case SHORT_TYPE: case BOOL_TYPE:
+		case STRING_TYPE:
+			ok = count == 0;
+			break;
+		default:
+			ok = false;
+		}
+		if (!ok){ bad(); }
+	}
+}
+
+}
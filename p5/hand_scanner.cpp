@@ -0,0 +1,329 @@
+#include <cstring>
+#include "byte_scan.hpp"
+#include "scanner.hpp"
+
+using namespace cminusminus;
+
+using TokenKind = cminusminus::Parser::token;
+using Lexeme = cminusminus::Parser::semantic_type;
+
+//A scanner written by hand, giving exactly the tokens (and
+// errors) of the flex rules in cminusminus.l. Rather than a
+// rule per keyword, it matches the shape of an identifier once
+// and then looks the word up in a perfect hash of the keywords.
+// Everything else is dispatched on its first byte through a
+// 256-entry table. Blanks, comments and the bodies of string
+// literals are skipped many bytes at a time (see ByteScan).
+
+namespace cminusminus{
+
+struct Keyword{
+	const char * text;
+	size_t len;
+	int kind;
+};
+
+static constexpr Keyword KEYWORDS[] = {
+	{ "int", 3, TokenKind::INT }, { "bool", 4, TokenKind::BOOL },
+	{ "short", 5, TokenKind::SHORT }, { "ptr", 3, TokenKind::PTR },
+	{ "string", 6, TokenKind::STRING }, { "void", 4, TokenKind::VOID },
+	{ "if", 2, TokenKind::IF }, { "else", 4, TokenKind::ELSE },
+	{ "while", 5, TokenKind::WHILE }, { "return", 6, TokenKind::RETURN },
+	{ "write", 5, TokenKind::WRITE }, { "read", 4, TokenKind::READ },
+	{ "false", 5, TokenKind::FALSE }, { "true", 4, TokenKind::TRUE },
+	{ "and", 3, TokenKind::AND }, { "or", 2, TokenKind::OR },
+	{ "gets", 4, TokenKind::ASSIGN },
+};
+static constexpr size_t MIN_KEYWORD = 2;
+static constexpr size_t MAX_KEYWORD = 6;
+static constexpr size_t KEYWORD_SLOTS = 32;
+
+//Only words of MIN_KEYWORD to MAX_KEYWORD bytes are hashed. The
+// multipliers were found by search, and the static_assert below
+// checks that no two keywords share a slot.
+static constexpr size_t keywordHash(const char * text, size_t len){
+	return (static_cast<size_t>(static_cast<unsigned char>(text[0]))
+		+ 2 * static_cast<size_t>(static_cast<unsigned char>(text[1]))
+		+ 19 * len) % KEYWORD_SLOTS;
+}
+
+struct KeywordTable{
+	Keyword slots[KEYWORD_SLOTS];
+	bool perfect;
+};
+
+static constexpr KeywordTable makeKeywordTable(){
+	KeywordTable table = {};
+	table.perfect = true;
+	for (const Keyword& word : KEYWORDS){
+		Keyword& slot = table.slots[keywordHash(word.text, word.len)];
+		if (slot.text != nullptr){ table.perfect = false; }
+		slot = word;
+	}
+	return table;
+}
+
+static constexpr KeywordTable KEYWORD_TABLE = makeKeywordTable();
+static_assert(KEYWORD_TABLE.perfect, "two keywords hash to one slot");
+
+//How a token starting with a given byte is lexed
+enum CharClass : uint8_t{
+	ILLEGAL, SPACE, NEWLINE, CR, WORD, DIGIT, QUOTE, HASH, OP
+};
+
+struct CharEntry{
+	CharClass cls;
+	//Whether the byte can continue an identifier
+	bool wordChar;
+	//For an OP, its token, and the second byte (if any) that
+	// makes a longer one, with that token
+	int kind;
+	char second;
+	int pairKind;
+};
+
+struct CharTable{
+	CharEntry entries[256];
+};
+
+static constexpr CharTable makeCharTable(){
+	CharTable table = {};
+	for (int c = 0; c < 256; c++){
+		CharEntry& entry = table.entries[c];
+		bool letter = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+			|| c == '_';
+		bool digit = c >= '0' && c <= '9';
+		entry.wordChar = letter || digit;
+		if (letter){ entry.cls = WORD; }
+		if (digit){ entry.cls = DIGIT; }
+	}
+	table.entries[static_cast<int>(' ')].cls = SPACE;
+	table.entries[static_cast<int>('\t')].cls = SPACE;
+	table.entries[static_cast<int>('\n')].cls = NEWLINE;
+	table.entries[static_cast<int>('\r')].cls = CR;
+	table.entries[static_cast<int>('"')].cls = QUOTE;
+	table.entries[static_cast<int>('#')].cls = HASH;
+	struct Op{ char first; int kind; char second; int pairKind; };
+	const Op ops[] = {
+		{ '{', TokenKind::LCURLY, 0, 0 }, { '}', TokenKind::RCURLY, 0, 0 },
+		{ '(', TokenKind::LPAREN, 0, 0 }, { ')', TokenKind::RPAREN, 0, 0 },
+		{ ';', TokenKind::SEMICOL, 0, 0 }, { ',', TokenKind::COMMA, 0, 0 },
+		{ '@', TokenKind::AT, 0, 0 }, { '&', TokenKind::AMP, 0, 0 },
+		{ '*', TokenKind::TIMES, 0, 0 }, { '/', TokenKind::DIVIDE, 0, 0 },
+		{ '+', TokenKind::PLUS, '+', TokenKind::INC },
+		{ '-', TokenKind::MINUS, '-', TokenKind::DEC },
+		{ '!', TokenKind::NOT, '=', TokenKind::NOTEQUALS },
+		{ '=', TokenKind::ASSIGN, '=', TokenKind::EQUALS },
+		{ '<', TokenKind::LESS, '=', TokenKind::LESSEQ },
+		{ '>', TokenKind::GREATER, '=', TokenKind::GREATEREQ },
+	};
+	for (const Op& op : ops){
+		CharEntry& entry = table.entries[static_cast<int>(op.first)];
+		entry.cls = OP;
+		entry.kind = op.kind;
+		entry.second = op.second;
+		entry.pairKind = op.pairKind;
+	}
+	return table;
+}
+
+static constexpr CharTable CHAR_TABLE = makeCharTable();
+
+static const CharEntry& charEntry(char c){
+	return CHAR_TABLE.entries[static_cast<unsigned char>(c)];
+}
+
+static bool isEscapee(char c){
+	return c == 'n' || c == 't' || c == '"' || c == '\\';
+}
+
+}
+
+int Scanner::handLex(Lexeme * const lval){
+	this->yylval = lval;
+	const char * text = source->data();
+	const size_t size = limit;
+	while (srcOffset < size){
+		tokOffset = srcOffset;
+		char c = text[srcOffset];
+		const CharEntry& entry = charEntry(c);
+		switch (entry.cls){
+		case SPACE: case NEWLINE:
+			//Most runs are one space between tokens, and are not
+			// worth a vector search
+			srcOffset++;
+			if (srcOffset < size && (charEntry(text[srcOffset]).cls == SPACE
+				|| charEntry(text[srcOffset]).cls == NEWLINE)){
+				srcOffset += ByteScan::blanks(text + srcOffset,
+					size - srcOffset);
+			}
+			continue;
+		case CR:
+			if (srcOffset + 1 < size && text[srcOffset + 1] == '\n'){
+				srcOffset += 2;
+				continue;
+			}
+			break;
+		case HASH:
+			srcOffset += ByteScan::lineEnd(text + srcOffset, size - srcOffset);
+			continue;
+		case WORD:
+			return handWord();
+		case DIGIT:
+			return handNumber();
+		case QUOTE:
+			if (handString()){ return TokenKind::STRLITERAL; }
+			continue;
+		case OP:
+			if (entry.second != 0 && srcOffset + 1 < size
+				&& text[srcOffset + 1] == entry.second){
+				srcOffset += 2;
+				return makeBareToken(entry.pairKind);
+			}
+			srcOffset++;
+			return makeBareToken(entry.kind);
+		case ILLEGAL:
+			break;
+		}
+		//Any other byte is illegal on its own
+		srcOffset++;
+		Position pos = tokenPos();
+		//As flex's yytext would, the text stops at a NUL byte
+		std::string match(text + tokOffset, 1);
+		errIllegal(&pos, match.c_str());
+	}
+	tokOffset = srcOffset;
+	return TokenKind::END;
+}
+
+int Scanner::handWord(){
+	const char * text = source->data();
+	const size_t size = limit;
+	size_t end = srcOffset + 1;
+	while (end < size && charEntry(text[end]).wordChar){ end++; }
+	srcOffset = end;
+	const char * word = text + tokOffset;
+	size_t len = end - tokOffset;
+	if (len >= MIN_KEYWORD && len <= MAX_KEYWORD){
+		const Keyword& slot = KEYWORD_TABLE.slots[keywordHash(word, len)];
+		if (slot.len == len && memcmp(slot.text, word, len) == 0){
+			return makeBareToken(slot.kind);
+		}
+	}
+	return makeIDToken(Interner::intern(word, len));
+}
+
+int Scanner::handNumber(){
+	const char * text = source->data();
+	const size_t size = limit;
+	size_t end = srcOffset;
+	while (end < size && text[end] >= '0' && text[end] <= '9'){ end++; }
+	size_t digitsEnd = end;
+	bool isShort = end < size && text[end] == 'S';
+	if (isShort){ end++; }
+	srcOffset = end;
+	if (isShort){ return makeShortLit(digitsEnd - tokOffset); }
+	return makeIntLit(digitsEnd - tokOffset);
+}
+
+//The four string rules can match overlapping text, and flex
+// takes the longest match, preferring the earlier rule on a
+// tie. The length each rule would match is found here, and
+// the winner chosen the same way. Returns true if the winner
+// is a good string literal, reporting the error otherwise.
+bool Scanner::handString(){
+	const char * text = source->data();
+	const size_t size = limit;
+	const size_t body = tokOffset + 1;
+
+	//A good literal, or an unterminated one: escapes from
+	// [nt"\\], and any byte but a quote, backslash or newline
+	size_t end = body;
+	bool sawBackslash = false;
+	while (end < size){
+		end += ByteScan::stringStop(text + end, size - end);
+		if (end == size){ break; }
+		char c = text[end];
+		if (c == '\\'){
+			sawBackslash = true;
+			if (end + 1 < size && isEscapee(text[end + 1])){
+				end += 2;
+				continue;
+			}
+			break;
+		}
+		//A quote or a newline
+		break;
+	}
+	size_t goodLen = 0;
+	if (end < size && text[end] == '"'){ goodLen = end + 1 - tokOffset; }
+	size_t untermLen = end - tokOffset;
+
+	//A literal with a bad escape, which is a backslash followed
+	// by nothing or by any byte that cannot be escaped. Each
+	// state is a set of positions in the pattern
+	// (STRELT* BADESC STRELT*)+, simulated byte by byte.
+	size_t badUntermLen = 0;
+	size_t badLen = 0;
+	if (sawBackslash){
+		enum : unsigned{
+			BEFORE = 1, BEFORE_ESC = 2, AFTER = 4, AFTER_ESC = 8,
+			BAD_ESC = 16
+		};
+		const unsigned ACCEPT = AFTER | BAD_ESC;
+		unsigned states = BEFORE;
+		for (size_t k = body; states != 0; k++){
+			bool more = k < size && text[k] != '\n';
+			char c = more ? text[k] : '\0';
+			if (states & ACCEPT){
+				//It can end here, take an escaped quote, or be closed
+				badUntermLen = k - tokOffset;
+				if (c == '\\' && k + 1 < size && text[k + 1] == '"'){
+					badUntermLen = k + 2 - tokOffset;
+				}
+				if (c == '"'){ badLen = k + 1 - tokOffset; }
+			}
+			if (!more){ break; }
+			bool plain = c != '\\' && c != '"';
+			unsigned next = 0;
+			if (states & BEFORE){
+				if (plain){ next |= BEFORE; }
+				if (c == '\\'){ next |= BEFORE_ESC | BAD_ESC; }
+			}
+			if ((states & BEFORE_ESC) && isEscapee(c)){ next |= BEFORE; }
+			if (states & (AFTER | BAD_ESC)){
+				if (plain){ next |= AFTER; }
+				if (c == '\\'){ next |= AFTER_ESC | BAD_ESC; }
+			}
+			if ((states & BAD_ESC) && !isEscapee(c)){ next |= AFTER; }
+			if ((states & AFTER_ESC) && isEscapee(c)){ next |= AFTER; }
+			states = next;
+		}
+	}
+
+	size_t len = goodLen;
+	int rule = 0;
+	const size_t lens[] = { untermLen, badUntermLen, badLen };
+	for (int k = 0; k < 3; k++){
+		if (lens[k] > len){
+			len = lens[k];
+			rule = k + 1;
+		}
+	}
+	srcOffset = tokOffset + len;
+	Position pos = tokenPos();
+	switch (rule){
+	case 0:
+		makeStrToken();
+		return true;
+	case 1:
+		errStrUnterm(&pos);
+		break;
+	case 2:
+		errStrEscAndUnterm(&pos);
+		break;
+	default:
+		errStrEsc(&pos);
+	}
+	return false;
+}
@@ -0,0 +1,87 @@
+#include <cstring>
+#include <mutex>
+#include <vector>
+#include "interner.hpp"
+
+namespace cminusminus{
+
+//The table is split into independently locked shards so that
+// concurrent lexers rarely wait on each other. Each shard is
+// an open-addressing table of (hash, string) slots.
+namespace {
+
+const size_t NUM_SHARDS = 64;
+
+struct Slot{
+	size_t hash;
+	std::string * str;
+};
+
+struct Shard{
+	std::mutex lock;
+	std::vector<Slot> slots = std::vector<Slot>(64, Slot{0, nullptr});
+	size_t count = 0;
+};
+
+Shard shards[NUM_SHARDS];
+
+//FNV-1a
+size_t hashBytes(const char * text, size_t len){
+	size_t h = 14695981039346656037ULL;
+	for (size_t i = 0; i < len; i++){
+		h ^= static_cast<unsigned char>(text[i]);
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+void grow(Shard& shard){
+	std::vector<Slot> old;
+	old.swap(shard.slots);
+	shard.slots.assign(old.size() * 2, Slot{0, nullptr});
+	size_t mask = shard.slots.size() - 1;
+	for (const Slot& slot : old){
+		if (slot.str == nullptr){ continue; }
+		size_t idx = (slot.hash >> 6) & mask;
+		while (shard.slots[idx].str != nullptr){ idx = (idx + 1) & mask; }
+		shard.slots[idx] = slot;
+	}
+}
+
+}
+
+Ident Interner::intern(const char * text, size_t len){
+	size_t hash = hashBytes(text, len);
+	Shard& shard = shards[hash % NUM_SHARDS];
+	std::lock_guard<std::mutex> guard(shard.lock);
+
+	size_t mask = shard.slots.size() - 1;
+	size_t idx = (hash >> 6) & mask;
+	while (true){
+		Slot& slot = shard.slots[idx];
+		if (slot.str == nullptr){ break; }
+		if (slot.hash == hash && slot.str->size() == len
+		  && memcmp(slot.str->data(), text, len) == 0){
+			return slot.str;
+		}
+		idx = (idx + 1) & mask;
+	}
+
+	std::string * str = new std::string(text, len);
+	shard.slots[idx] = Slot{hash, str};
+	shard.count++;
+	//Keep the load factor at or below one half
+	if (shard.count * 2 > shard.slots.size()){ grow(shard); }
+	return str;
+}
+
+size_t Interner::size(){
+	size_t total = 0;
+	for (Shard& shard : shards){
+		std::lock_guard<std::mutex> guard(shard.lock);
+		total += shard.count;
+	}
+	return total;
+}
+
+}
@@ -0,0 +1,32 @@
+#ifndef CMINUSMINUS_INTERNER_HPP
+#define CMINUSMINUS_INTERNER_HPP
+
+#include <string>
+
+namespace cminusminus{
+
+//An interned identifier. Every occurrence of the same spelling
+// maps to the same handle, so identifiers can be compared and
+// hashed as plain pointers. The string it points to is never
+// moved or freed.
+using Ident = const std::string *;
+
+//The process-wide table of identifier spellings, shared by the
+// lexer, the AST and the symbol tables. It is safe to intern
+// from several threads at once (batch mode does).
+class Interner{
+public:
+	//Look up (adding it if needed) the handle for len bytes
+	// at text. Looking up a spelling that is already present
+	// does not allocate.
+	static Ident intern(const char * text, size_t len);
+	static Ident intern(const std::string& text){
+		return intern(text.data(), text.size());
+	}
+	//The number of distinct spellings interned so far
+	static size_t size();
+};
+
+}
+
+#endif
@@ -2,10 +2,14 @@
 #include <cstdlib>
 #include <cstring>
 #include <fstream>
+#include <sstream>
+#include <condition_variable>
+#include <mutex>
+#include "compile_cache.hpp"
 #include "errors.hpp"
-#include "scanner.hpp"
-#include "name_analysis.hpp"
-#include "type_analysis.hpp"
+#include "session.hpp"
+#include "stats.hpp"
+#include "worker_pool.hpp"
 
 using namespace cminusminus;
 
@@ -16,204 +20,581 @@ static void usageAndDie(){
 	<< " [-u <unparseFile>]: Output canonical program form\n"
 	<< " [-n <nameFile>]: Output program with IDs annotated with symbols\n"
 	<< " [-c]: Perform type analysis / typecheck the program\n"
+	<< "Batch mode: cmmc <infile> <infile>... | @<listFile>\n"
+	<< " [-j <workers>]: Number of worker threads (default: one per core)\n"
+	<< " [-threads <n>]: Threads used to lex a large file and to\n"
+	<< "  analyze the functions of each file (default 1)\n"
+	<< " [-fused]: Resolve names and check types in one traversal\n"
+	<< " [-flat]: Unparse and analyze a flat table of the AST\n"
+	<< " [-hand-lexer]: Lex with the hand-written scanner rather than\n"
+	<< "  the flex one\n"
+	<< " [-token-buffer]: Lex the whole input into a packed token array\n"
+	<< "  before parsing it\n"
+	<< " [-emit-ast <astFile>]: Save the AST in binary form. A saved\n"
+	<< "  AST can be given as <infile> in place of its source, and is\n"
+	<< "  loaded without lexing or parsing (it implies -flat)\n"
+	<< "Caching:\n"
+	<< " [-cache <dir>]: Keep the outputs of each compilation in <dir>,\n"
+	<< "  and replay them when the same input is compiled with the same\n"
+	<< "  flags by the same cmmc (not with -emit-ast)\n"
+	<< " [-cache-size <bytes>]: Evict the least recently used entries\n"
+	<< "  beyond this size, with K/M/G suffixes (default 256M)\n"
+	<< "Statistics:\n"
+	<< " [-stats | -ftime-report]: Print per-phase times, allocations and\n"
+	<< "  front-end counters to stderr\n"
+	<< " [-stats-json <statsFile>]: Write the same statistics as JSON\n"
+	<< "Diagnostics:\n"
+	<< " [-error-limit <n>]: Stop compiling a file after <n> errors\n"
+	<< " [-sort-errors]: Write errors in source order\n"
+	<< " In batch mode the <tokensFile>, <unparseFile> and <nameFile>\n"
+	<< " arguments are suffixes appended to each input path, and \"--\"\n"
+	<< " writes every file's output to stdout in input order\n"
 	;
 	exit(1);
 }
 
-static void writeTokenStream(const char * inPath, const char * outPath){
-	std::ifstream inStream(inPath);
-	if (!inStream.good()){
-		std::string msg = "Bad input stream";
-		msg += inPath;
-		throw new InternalError(msg.c_str());
+//The outputs requested on the command line, shared by
+// every input file
+struct Options{
+	const char * tokensFile = nullptr;
+	bool checkParse = false;
+	const char * unparseFile = nullptr;
+	const char * namesFile = nullptr;
+	bool checkTypes = false;
+	bool batch = false;
+	bool statsText = false;
+	const char * statsJSON = nullptr;
+	size_t errorLimit = 0;
+	bool sortErrors = false;
+	size_t threads = 1;
+	bool fused = false;
+	bool flat = false;
+	bool handLexer = false;
+	bool tokenBuffer = false;
+	const char * astFile = nullptr;
+	CompileCache * cache = nullptr;
+	//The flags that go into the cache key (see cacheFlags)
+	std::string cacheFlags;
+	bool wantStats() const { return statsText || statsJSON != nullptr; }
+};
+
+//Where a per-file output should be written. In batch mode
+// the path from the command line is a suffix for the input
+static std::string outputPath(const Options& opts, const char * inFile,
+	const char * outPath){
+	if (!opts.batch || strcmp(outPath, "--") == 0){ return outPath; }
+	return std::string(inFile) + outPath;
+}
+
+//Write one per-file output, to a file or (for "--") to stdout,
+// where write(out) writes it to the given stream. When the
+// compilation is being recorded for the cache, a copy of what
+// goes to a file is kept in record.
+template <typename Write>
+static void writeOutput(const std::string& outPath, CachedCompile * record,
+	CachedCompile::Output which, Write write){
+	if (outPath == "--"){
+		write(Report::out());
+		return;
 	}
-	if (outPath == nullptr){
-		std::string msg = "No tokens output file given";
+	std::ofstream outStream(outPath);
+	if (!outStream.good()){
+		//The failure is not the input's, so is not kept
+		if (record != nullptr){ record->cacheable = false; }
+		std::string msg = "Bad output file ";
+		msg += outPath;
 		throw new InternalError(msg.c_str());
 	}
+	if (record == nullptr){
+		write(outStream);
+		return;
+	}
+	std::ostringstream copy;
+	write(copy);
+	record->hasFile[which] = true;
+	record->files[which] = copy.str();
+	outStream << record->files[which];
+}
 
-	Scanner scanner(&inStream);
-	if (strcmp(outPath, "--") == 0){
-		scanner.outputTokens(std::cout);
-	} else {
-		std::ofstream outStream(outPath);
-		if (!outStream.good()){
-			std::string msg = "Bad output file ";
-			msg += outPath;
-			throw new InternalError(msg.c_str());
+static void writeTokenStream(Session * session, const std::string& outPath,
+	CachedCompile * record){
+	writeOutput(outPath, record, CachedCompile::TOKENS,
+		[&](std::ostream& out){ session->writeTokens(out); });
+}
+
+//Write an unparsed program, where unparse(out) writes it to
+// the given stream
+template <typename Unparse>
+static void outputAST(const std::string& outPath, CachedCompile * record,
+	CachedCompile::Output which, Unparse unparse){
+	PhaseTimer timer(Stats::UNPARSE);
+	writeOutput(outPath, record, which, unparse);
+}
+
+static bool doUnparsing(Session * session, const std::string& outPath,
+	bool flat, CachedCompile * record){
+	if (flat){
+		FlatAST * flatAST = session->flatAST();
+		if (flatAST == nullptr){
+			Report::err() << "No AST built\n";
+			return false;
 		}
-		scanner.outputTokens(outStream);
-		outStream.close();
+		outputAST(outPath, record, CachedCompile::UNPARSE,
+			[&](std::ostream& out){ flatAST->unparse(out); });
+		return true;
+	}
+
+	cminusminus::ProgramNode * ast = session->ast();
+	if (ast == nullptr){ 
+		Report::err() << "No AST built\n";
+		return false;
 	}
+
+	outputAST(outPath, record, CachedCompile::UNPARSE,
+		[&](std::ostream& out){ ast->unparse(out, 0); });
+	return true;
 }
 
-static cminusminus::ProgramNode * parse(const char * inFile){
-	std::ifstream inStream(inFile);
-	if (!inStream.good()){
-		std::string msg = "Bad input stream ";
-		msg += inFile;
-		throw new UserError(msg.c_str());
+static bool saveAST(Session * session, const std::string& outPath){
+	FlatAST * flatAST = session->flatAST();
+	if (flatAST == nullptr){
+		Report::err() << "No AST built\n";
+		return false;
+	}
+	if (outPath == "--"){
+		flatAST->save(Report::out());
+		return true;
 	}
+	std::ofstream outStream(outPath, std::ios::binary);
+	if (!outStream.good()){
+		std::string msg = "Bad output file ";
+		msg += outPath;
+		throw new InternalError(msg.c_str());
+	}
+	flatAST->save(outStream);
+	return true;
+}
 
-	//This pointer will be set to the root of the
-	// AST after parsing
-	cminusminus::ProgramNode * root = nullptr;
+//The -n and -c stages over the flat AST
+static int flatAnalyses(Session * session, const Options& opts,
+	const char * inFile, CachedCompile * record){
+	if (opts.namesFile){
+		FlatNameAnalysis * na = session->flatNameAnalysis();
+		if (na == nullptr){
+			Report::err() << "Name Analysis Failed\n";
+			return 1;
+		}
+		outputAST(outputPath(opts, inFile, opts.namesFile), record,
+			CachedCompile::NAMES,
+			[&](std::ostream& out){ na->ast->unparse(out, &na->symbols); });
+	}
+	if (opts.checkTypes){
+		if (session->flatTypeAnalysis() == nullptr){
+			Report::err() << "Type Analysis Failed\n";
+			return 1;
+		}
+		Report::out() << "Great job! Type analysis succeeded\n";
+	}
+	return 0;
+}
 
-	cminusminus::Scanner scanner(&inStream);
-	cminusminus::Parser parser(scanner, &root);
+//Run every requested stage on one input file. When record is
+// not null, the outputs written to files are copied into it.
+// source, if not null, is the input already mapped, which the
+// compilation takes over.
+static int compileStages(const char * inFile, const Options& opts,
+	CachedCompile * record, SourceBuffer * source = nullptr){
+	try {
+		//Every requested output shares the one session, so
+		// the input is lexed and parsed only once
+		Session session(inFile, opts.threads, source);
+		session.setFused(opts.fused);
+		session.setHandLexer(opts.handLexer);
+		session.setTokenBuffer(opts.tokenBuffer);
+		bool flat = opts.flat || session.savedAST();
+		if (opts.tokensFile != nullptr){
+			writeTokenStream(&session,
+				outputPath(opts, inFile, opts.tokensFile), record);
+		}
+		if (opts.checkParse){
+			bool parsed = flat ? session.flatAST() != nullptr
+				: session.ast() != nullptr;
+			if (!parsed){
+				Report::err() << "Parse failed" << std::endl;
+			}
+		}
+		if (opts.unparseFile != nullptr){
+			doUnparsing(&session,
+				outputPath(opts, inFile, opts.unparseFile), flat, record);
+		}
+		if (opts.astFile != nullptr){
+			saveAST(&session, outputPath(opts, inFile, opts.astFile));
+		}
+		if (flat){
+			return flatAnalyses(&session, opts, inFile, record);
+		}
+		if (opts.namesFile){
+			cminusminus::NameAnalysis * na;
+			na = session.nameAnalysis();
+			if (na == nullptr){
+				Report::err() << "Name Analysis Failed\n";
+				return 1;
+			}
+			ProgramNode * ast = na->ast;
+			outputAST(outputPath(opts, inFile, opts.namesFile), record,
+				CachedCompile::NAMES,
+				[&](std::ostream& out){ ast->unparse(out, 0); });
+		}
+		if (opts.checkTypes){
+			cminusminus::TypeAnalysis * ta;
+			ta = session.typeAnalysis();
+			if (ta == nullptr){
+				Report::err() << "Type Analysis Failed\n";
+				return 1;
+			} else {
+				Report::out() << "Great job! Type analysis succeeded\n";
+			}
+		}
+	} catch (cminusminus::ToDoError * e){
+		Report::err() << "ToDoError: " << e->msg() << "\n";
+		return 1;
+	} catch (cminusminus::InternalError * e){
+		std::string msg = "Something in the compiler is broken: ";
+		Report::err() << msg << e->msg() << std::endl;
+		return 1;
+	} catch (UserError * e){
+		std::string msg = "The user made a mistake: ";
+		Report::err() << msg << e->msg() << std::endl;
+		return 1;
+	} catch (cminusminus::ErrorLimitReached * e){
+		Report::err() << e->msg() << std::endl;
+		return 1;
+	}
+	return 0;
+}
 
-	int errCode = parser.parse();
-	if (errCode != 0){ return nullptr; }
+//The flags that shape what a compilation writes, for the cache
+// key. Output paths are left out, since a hit writes to the
+// paths given this time, but whether each output goes to
+// stdout is not. The worker counts change nothing that is
+// written, so are left out too.
+static std::string cacheFlags(const Options& opts){
+	auto dest = [](const char * path){
+		if (path == nullptr){ return "none"; }
+		return strcmp(path, "--") == 0 ? "stdout" : "file";
+	};
+	std::ostringstream flags;
+	flags << "t=" << dest(opts.tokensFile)
+		<< " p=" << opts.checkParse
+		<< " u=" << dest(opts.unparseFile)
+		<< " n=" << dest(opts.namesFile)
+		<< " c=" << opts.checkTypes
+		<< " fused=" << opts.fused
+		<< " flat=" << opts.flat
+		<< " error-limit=" << opts.errorLimit
+		<< " sort-errors=" << opts.sortErrors;
+	return flags.str();
+}
 
-	return root;
+//Write out a compilation found in the cache. Returns false,
+// having written nothing, if an output file cannot be opened.
+static bool replay(const CachedCompile& entry, const Options& opts,
+	const char * inFile){
+	const char * paths[CachedCompile::NUM_OUTPUTS] = {
+		opts.tokensFile, opts.unparseFile, opts.namesFile };
+	std::ofstream files[CachedCompile::NUM_OUTPUTS];
+	for (int k = 0; k < CachedCompile::NUM_OUTPUTS; k++){
+		if (!entry.hasFile[k]){ continue; }
+		files[k].open(outputPath(opts, inFile, paths[k]));
+		if (!files[k].good()){ return false; }
+	}
+	for (int k = 0; k < CachedCompile::NUM_OUTPUTS; k++){
+		if (entry.hasFile[k]){ files[k] << entry.files[k]; }
+	}
+	Report::out() << entry.out;
+	Report::err() << entry.err;
+	return true;
 }
 
-static void outputAST(ASTNode * ast, const char * outPath){
-	if (strcmp(outPath, "--") == 0){
-		ast->unparse(std::cout, 0);
-	} else {
-		std::ofstream outStream(outPath);
-		if (!outStream.good()){
-			std::string msg = "Bad output file ";
-			msg += outPath;
-			throw new cminusminus::InternalError(msg.c_str());
+//Replay a cached compilation of the same bytes with the same
+// flags, or compile the file and store what it wrote. The file
+// is mapped once, both for its key and to be compiled.
+static int compileCached(const char * inFile, const Options& opts){
+	SourceBuffer * source = SourceBuffer::map(inFile);
+	if (source == nullptr){ return compileStages(inFile, opts, nullptr); }
+	std::string key = opts.cache->key(source->data(), source->size(),
+		opts.cacheFlags);
+	CachedCompile entry;
+	if (opts.cache->lookup(key, entry)){
+		if (replay(entry, opts, inFile)){
+			delete source;
+			return entry.status;
 		}
-		ast->unparse(outStream, 0);
+		//Compiling reports the output file that is missing
+		return compileStages(inFile, opts, nullptr, source);
 	}
+
+	//Capture what the compilation writes to stdout and stderr,
+	// then pass it on
+	std::ostream * out = &Report::out();
+	std::ostream * err = &Report::err();
+	std::ostringstream outCopy;
+	std::ostringstream errCopy;
+	Report::redirect(&outCopy, &errCopy);
+	entry.status = compileStages(inFile, opts, &entry, source);
+	Report::flushDiagnostics();
+	Report::redirect(out, err);
+	entry.out = outCopy.str();
+	entry.err = errCopy.str();
+	*out << entry.out;
+	*err << entry.err;
+	opts.cache->store(key, entry);
+	return entry.status;
 }
 
-static cminusminus::NameAnalysis * doNameAnalysis(const char * inputPath){
-	cminusminus::ProgramNode * ast = parse(inputPath);
-	if (ast == nullptr){ return nullptr; }
-	
-	return cminusminus::NameAnalysis::build(ast);
+//Run every requested stage on one input file, writing to the
+// calling thread's Report streams. Returns the exit status.
+// Statistics are gathered into stats, if it is not null.
+static int compileFile(const char * inFile, const Options& opts,
+	Stats * stats){
+	StatsScope statsScope(stats);
+	if (stats != nullptr){ stats->files++; }
+	Diagnostics::current().configure(opts.errorLimit, opts.sortErrors);
+	int status = opts.cache == nullptr ? compileStages(inFile, opts, nullptr)
+		: compileCached(inFile, opts);
+	Report::flushDiagnostics();
+	return status;
 }
 
-static bool doUnparsing(const char * inputPath, const char * outPath){
-	cminusminus::ProgramNode * ast = parse(inputPath);
-	if (ast == nullptr){ 
-		std::cerr << "No AST built\n";
-		return false;
+//A size in bytes, with an optional K, M or G suffix
+static size_t parseByteSize(const char * text){
+	char * end = nullptr;
+	unsigned long long size = strtoull(text, &end, 10);
+	if (end == text){ usageAndDie(); }
+	switch (*end){
+	case 'K': case 'k': size <<= 10; end++; break;
+	case 'M': case 'm': size <<= 20; end++; break;
+	case 'G': case 'g': size <<= 30; end++; break;
+	default: break;
 	}
+	if (*end != '\0'){ usageAndDie(); }
+	return static_cast<size_t>(size);
+}
 
-	outputAST(ast, outPath);
-	return true;
+//Append the paths listed (one per line) in a response file
+static void readListFile(const char * listPath,
+	std::vector<std::string>& inFiles){
+	std::ifstream list(listPath);
+	if (!list.good()){
+		std::cerr << "Bad path " << listPath << std::endl;
+		usageAndDie();
+	}
+	std::string line;
+	while (std::getline(list, line)){
+		if (!line.empty() && line.back() == '\r'){ line.pop_back(); }
+		if (!line.empty()){ inFiles.push_back(line); }
+	}
 }
 
-static cminusminus::TypeAnalysis * doTypeAnalysis(const char * inputPath){
-	cminusminus::NameAnalysis * nameAnalysis = doNameAnalysis(inputPath);
-	if (nameAnalysis == nullptr){ return nullptr; }
-	return TypeAnalysis::build(nameAnalysis);
+//The captured output of one file in batch mode
+struct BatchResult{
+	std::ostringstream out;
+	std::ostringstream err;
+	int status = 0;
+	bool done = false;
+	Stats stats;
+};
+
+//Compile every input on a pool of worker threads. Each file's
+// stdout and stderr are buffered and then written out in
+// input order, so the combined output does not depend on
+// which worker happened to finish first.
+static int compileBatch(const std::vector<std::string>& inFiles,
+	const Options& opts, size_t numWorkers, Stats * stats){
+	std::vector<BatchResult> results(inFiles.size());
+	std::mutex resultsLock;
+	std::condition_variable resultReady;
+
+	WorkerPool pool(numWorkers);
+	for (size_t k = 0; k < inFiles.size(); k++){
+		pool.submit([&, k]{
+			BatchResult& res = results[k];
+			Report::redirect(&res.out, &res.err);
+			int status = compileFile(inFiles[k].c_str(), opts,
+				stats == nullptr ? nullptr : &res.stats);
+			Report::redirect(&std::cout, &std::cerr);
+			std::lock_guard<std::mutex> guard(resultsLock);
+			res.status = status;
+			res.done = true;
+			resultReady.notify_all();
+		});
+	}
+
+	int status = 0;
+	for (size_t k = 0; k < inFiles.size(); k++){
+		BatchResult& res = results[k];
+		{
+			std::unique_lock<std::mutex> guard(resultsLock);
+			resultReady.wait(guard, [&res]{ return res.done; });
+		}
+		std::cout << res.out.str();
+		std::string errText = res.err.str();
+		if (!errText.empty()){
+			std::cerr << inFiles[k] << ":\n" << errText;
+		}
+		res.out.str("");
+		res.err.str("");
+		if (stats != nullptr){ stats->merge(res.stats); }
+		if (res.status != 0){ status = 1; }
+	}
+	pool.wait();
+	return status;
+}
+
+static void reportStats(const Stats& stats, const Options& opts){
+	if (opts.statsText){ stats.writeText(std::cerr); }
+	if (opts.statsJSON == nullptr){ return; }
+	if (strcmp(opts.statsJSON, "--") == 0){
+		stats.writeJSON(std::cout);
+		return;
+	}
+	std::ofstream outStream(opts.statsJSON);
+	if (!outStream.good()){
+		std::cerr << "Bad output file " << opts.statsJSON << std::endl;
+		return;
+	}
+	stats.writeJSON(outStream);
 }
 
 int 
 main( const int argc, const char **argv )
 {
 	if (argc <= 1){ usageAndDie(); }
-	std::ifstream * input = new std::ifstream(argv[1]);
-	if (input == nullptr){ usageAndDie(); }
-	if (!input->good()){
-		std::cerr << "Bad path " << argv[1] << std::endl;
-		usageAndDie();
+	if (argv[1][0] != '@'){
+		std::ifstream * input = new std::ifstream(argv[1]);
+		if (input == nullptr){ usageAndDie(); }
+		if (!input->good()){
+			std::cerr << "Bad path " << argv[1] << std::endl;
+			usageAndDie();
+		}
+		delete input;
 	}
 
-	const char * inFile = NULL;
-	const char * tokensFile = NULL;
-	bool checkParse = false;
-	const char * unparseFile = NULL;
-	const char * namesFile = NULL;
-	bool checkTypes = false;
+	std::vector<std::string> inFiles;
+	Options opts;
+	size_t numWorkers = 0;
+	const char * cacheDir = nullptr;
+	size_t cacheSize = 256 * 1024 * 1024;
 
 	bool useful = false;
-	int i = 1;
 	for (int i = 1 ; i < argc ; i++){
 		if (argv[i][0] == '-'){
-			if (argv[i][1] == 't'){
+			//Whole-word flags come first, so that they are not
+			// taken for the single-letter ones
+			if (strcmp(argv[i], "-stats") == 0
+				|| strcmp(argv[i], "-ftime-report") == 0){
+				opts.statsText = true;
+			} else if (strcmp(argv[i], "-stats-json") == 0){
+				i++;
+				if (i >= argc){ usageAndDie(); }
+				opts.statsJSON = argv[i];
+			} else if (strcmp(argv[i], "-error-limit") == 0){
+				i++;
+				if (i >= argc){ usageAndDie(); }
+				int limit = atoi(argv[i]);
+				if (limit < 0){ usageAndDie(); }
+				opts.errorLimit = static_cast<size_t>(limit);
+			} else if (strcmp(argv[i], "-sort-errors") == 0){
+				opts.sortErrors = true;
+			} else if (strcmp(argv[i], "-threads") == 0){
 				i++;
-				tokensFile = argv[i];
+				if (i >= argc){ usageAndDie(); }
+				int threads = atoi(argv[i]);
+				if (threads <= 0){ usageAndDie(); }
+				opts.threads = static_cast<size_t>(threads);
+			} else if (strcmp(argv[i], "-fused") == 0){
+				opts.fused = true;
+			} else if (strcmp(argv[i], "-flat") == 0){
+				opts.flat = true;
+			} else if (strcmp(argv[i], "-hand-lexer") == 0){
+				opts.handLexer = true;
+			} else if (strcmp(argv[i], "-token-buffer") == 0){
+				opts.tokenBuffer = true;
+			} else if (strcmp(argv[i], "-emit-ast") == 0){
+				i++;
+				if (i >= argc){ usageAndDie(); }
+				opts.astFile = argv[i];
+				useful = true;
+			} else if (strcmp(argv[i], "-cache") == 0){
+				i++;
+				if (i >= argc){ usageAndDie(); }
+				cacheDir = argv[i];
+			} else if (strcmp(argv[i], "-cache-size") == 0){
+				i++;
+				if (i >= argc){ usageAndDie(); }
+				cacheSize = parseByteSize(argv[i]);
+			} else if (argv[i][1] == 't'){
+				i++;
+				opts.tokensFile = argv[i];
 				useful = true;
 			} else if (argv[i][1] == 'p'){
-				checkParse = true;
+				opts.checkParse = true;
 				useful = true;
 			} else if (argv[i][1] == 'u'){
 				i++;
 				if (i >= argc){ usageAndDie(); }
-				unparseFile = argv[i];
+				opts.unparseFile = argv[i];
 				useful = true;
 			} else if (argv[i][1] == 'n'){
 				i++;
 				if (i >= argc){ usageAndDie(); }
-				namesFile = argv[i];
+				opts.namesFile = argv[i];
 				useful = true;
 			} else if (argv[i][1] == 'c'){
-				checkTypes = true;
+				opts.checkTypes = true;
 				useful = true;
+			} else if (argv[i][1] == 'j'){
+				i++;
+				if (i >= argc){ usageAndDie(); }
+				int workers = atoi(argv[i]);
+				if (workers <= 0){ usageAndDie(); }
+				numWorkers = static_cast<size_t>(workers);
+				opts.batch = true;
 			} else {
 				std::cerr << "Unrecognized argument: ";
 				std::cerr << argv[i] << std::endl;
 				usageAndDie();
 			}
+		} else if (argv[i][0] == '@'){
+			readListFile(argv[i] + 1, inFiles);
+			opts.batch = true;
 		} else {
-			if (inFile == NULL){
-				inFile = argv[i];
-			} else {
-				std::cerr << "Only 1 input file allowed";
-				std::cerr << argv[i] << std::endl;
-				usageAndDie();
-			}
+			inFiles.push_back(argv[i]);
 		}
 	}
-	if (inFile == NULL){
+	if (inFiles.empty()){
 		usageAndDie();
 	}
 	if (!useful){
 		std::cerr << "Hey, you didn't tell cmmc to do anything!\n";
 		usageAndDie();
 	}
+	if (inFiles.size() > 1){ opts.batch = true; }
+	//A saved AST is binary, so is left out of the cache
+	if (cacheDir != nullptr && opts.astFile == nullptr){
+		opts.cache = new CompileCache(cacheDir, cacheSize);
+		opts.cacheFlags = cacheFlags(opts);
+	}
 
-	try {
-		if (tokensFile != nullptr){
-			writeTokenStream(inFile, tokensFile);
-		}
-		if (checkParse){
-			bool parsed = parse(inFile);
-			if (!parsed){
-				std::cerr << "Parse failed" << std::endl;
-			}
-		}
-		if (unparseFile != nullptr){
-			doUnparsing(inFile, unparseFile);
-		}
-		if (namesFile){
-			cminusminus::NameAnalysis * na;
-			na = doNameAnalysis(inFile);
-			if (na == nullptr){
-				std::cerr << "Name Analysis Failed\n";
-				return 1;
-			}
-			outputAST(na->ast, namesFile);
-		}
-		if (checkTypes){
-			cminusminus::TypeAnalysis * ta;
-			ta = doTypeAnalysis(inFile);
-			if (ta == nullptr){
-				std::cerr << "Type Analysis Failed\n";
-				return 1;
-			} else {
-				std::cout << "Great job! Type analysis succeeded\n";
-			}
-		}
-	} catch (cminusminus::ToDoError * e){
-		std::cerr << "ToDoError: " << e->msg() << "\n";
-		exit(1);
-	} catch (cminusminus::InternalError * e){
-		std::string msg = "Something in the compiler is broken: ";
-		std::cerr << msg << e->msg() << std::endl;
-		exit(1);
-	} catch (UserError * e){
-		std::string msg = "The user made a mistake: ";
-		std::cerr << msg << e->msg() << std::endl;
-		exit(1);
+	Stats stats;
+	Stats * statsOut = opts.wantStats() ? &stats : nullptr;
+	int status;
+	if (opts.batch){
+		if (numWorkers == 0){ numWorkers = WorkerPool::defaultSize(); }
+		status = compileBatch(inFiles, opts, numWorkers, statsOut);
+	} else {
+		status = compileFile(inFiles.front().c_str(), opts, statsOut);
 	}
-	return 0;
+	if (statsOut != nullptr){ reportStats(stats, opts); }
+	return status;
 }
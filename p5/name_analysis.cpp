@@ -1,10 +1,125 @@
+#include <algorithm>
+#include <exception>
 #include "ast.hpp"
 #include "symbol_table.hpp"
 #include "errName.hpp"
 #include "types.hpp"
+#include "name_analysis.hpp"
+#include "type_analysis.hpp"
+#include "worker_pool.hpp"
 
 namespace cminusminus{
 
+//The results of resolving one global. A function is resolved
+// in two parts, its header and its body, that run at
+// different times and keep their diagnostics apart until
+// they are put back in program order.
+struct NameUnit{
+	DeclNode * decl;
+	FnDeclNode * fn;
+	std::vector<SemSymbol *> formals;
+	Diagnostics declDiags;
+	Diagnostics bodyDiags;
+	bool declOk = true;
+	bool bodyOk = true;
+	std::exception_ptr failure;
+};
+
+bool NameAnalysis::analyzeInParallel(ProgramNode * ast, size_t workers){
+	const NodeList<DeclNode *> * globals = ast->getGlobals();
+	std::vector<NameUnit> units;
+	units.reserve(globals->size());
+	for (DeclNode * decl : *globals){
+		units.push_back(NameUnit());
+		units.back().decl = decl;
+		units.back().fn = decl->asFnDecl();
+	}
+
+	//First declare every global in order, exactly as the
+	// sequential pass does, but leaving function bodies for
+	// later. Each global's diagnostics are kept separately.
+	GlobalScope frozen;
+	size_t declared = 0;
+	{
+		SymbolTable symTab;
+		ScopeTable globalScope = symTab.enterScope();
+		for (NameUnit& unit : units){
+			declared++;
+			DiagnosticsScope diagsScope(&unit.declDiags);
+			try {
+				if (unit.fn != nullptr){
+					unit.declOk = unit.fn->nameAnalysisHeader(&symTab);
+					unit.formals = symTab.currentScopeSymbols();
+					symTab.leaveScope();
+				} else {
+					unit.declOk = unit.decl->nameAnalysis(&symTab);
+				}
+			} catch (...) {
+				unit.failure = std::current_exception();
+				break;
+			}
+			Ident name = unit.decl->ID()->getIdent();
+			SemSymbol * sym = globalScope.lookup(name);
+			if (sym != nullptr && !frozen.contains(name)){
+				frozen.add(sym, declared - 1);
+			}
+		}
+	}
+
+	//Then resolve the bodies, in runs of consecutive globals.
+	// Nothing is declared at global level any more, so the
+	// workers only read the frozen scope.
+	size_t numRuns = std::min(declared, workers * 4);
+	Stats * stats = Stats::current();
+	std::vector<Stats> runStats(numRuns);
+	{
+		WorkerPool pool(std::min(workers, numRuns));
+		for (size_t r = 0; r < numRuns; r++){
+			pool.submit([&, r]{
+				StatsScope statsScope(stats == nullptr ? nullptr : &runStats[r]);
+				WorkerTimer timer(Stats::NAME_ANALYSIS);
+				SymbolTable symTab(&frozen);
+				symTab.enterScope();
+				size_t begin = declared * r / numRuns;
+				size_t end = declared * (r + 1) / numRuns;
+				for (size_t i = begin; i < end; i++){
+					NameUnit& unit = units[i];
+					if (unit.fn == nullptr || unit.failure){ continue; }
+					DiagnosticsScope diagsScope(&unit.bodyDiags);
+					symTab.showGlobalsTo(i);
+					ScopeTable fnScope = symTab.enterScope();
+					for (SemSymbol * formal : unit.formals){
+						fnScope.insert(formal);
+					}
+					try {
+						unit.bodyOk = unit.fn->nameAnalysisBody(&symTab);
+					} catch (...) {
+						//Later globals would not have been reached
+						unit.failure = std::current_exception();
+						return;
+					}
+				}
+			});
+		}
+		pool.wait();
+	}
+
+	//Report everything in the order of the sequential pass
+	Diagnostics& diags = Diagnostics::current();
+	bool res = true;
+	for (size_t i = 0; i < declared; i++){
+		NameUnit& unit = units[i];
+		diags.append(unit.declDiags);
+		diags.append(unit.bodyDiags);
+		if (unit.failure){ std::rethrow_exception(unit.failure); }
+		res = unit.declOk && unit.bodyOk && res;
+	}
+	if (stats != nullptr){
+		for (Stats& run : runStats){ stats->merge(run); }
+	}
+	return res;
+}
+
 bool ProgramNode::nameAnalysis(SymbolTable * symTab){
 	//Enter the global scope
 	symTab->enterScope();
@@ -17,6 +132,63 @@ bool ProgramNode::nameAnalysis(SymbolTable * symTab){
 	return res;
 }
 
+NameAnalysis * NameAnalysis::buildFused(ProgramNode * astIn,
+	TypeAnalysis ** typesOut){
+	TypeAnalysis * types = TypeAnalysis::startFused(astIn);
+	SymbolTable * symTab = new SymbolTable();
+	bool res = astIn->nameAndTypeAnalysis(symTab, types);
+	delete symTab;
+	if (!res){
+		delete types;
+		*typesOut = nullptr;
+		return nullptr;
+	}
+	*typesOut = types;
+	NameAnalysis * nameAnalysis = new NameAnalysis;
+	nameAnalysis->ast = astIn;
+	return nameAnalysis;
+}
+
+bool ProgramNode::nameAndTypeAnalysis(SymbolTable * symTab,
+	TypeAnalysis * ta){
+	symTab->enterScope();
+	bool res = true;
+	for (auto decl : *myGlobals){
+		bool valid;
+		FnDeclNode * fn = decl->asFnDecl();
+		if (fn != nullptr){
+			valid = fn->nameAndTypeAnalysis(symTab, ta);
+		} else {
+			valid = decl->nameAnalysis(symTab);
+			if (!valid){ ta->stopFused(); }
+			ta->checkFused([&]{ decl->typeAnalysis(ta); });
+		}
+		res = valid && res;
+	}
+	symTab->leaveScope();
+	ta->checkFused([&]{ ta->nodeType(this, BasicType::produce(VOID)); });
+	return res;
+}
+
+bool FnDeclNode::nameAndTypeAnalysis(SymbolTable * symTab,
+	TypeAnalysis * ta){
+	bool validHeader = nameAnalysisHeader(symTab);
+	if (!validHeader){ ta->stopFused(); }
+	ta->checkFused([&]{ typeAnalysisHeader(ta); });
+
+	//Each statement is checked right after it is resolved
+	bool validBody = true;
+	for (auto stmt : *myBody){
+		bool valid = stmt->nameAnalysis(symTab);
+		if (!valid){ ta->stopFused(); }
+		ta->checkFused([&]{ stmt->typeAnalysis(ta); });
+		validBody = valid && validBody;
+	}
+
+	symTab->leaveScope();
+	return validHeader && validBody;
+}
+
 bool AssignStmtNode::nameAnalysis(SymbolTable * symTab){
 	return myExp->nameAnalysis(symTab);
 }
@@ -79,7 +251,7 @@ bool VarDeclNode::nameAnalysis(SymbolTable * symTab){
 	bool checkType = myType->nameAnalysis(symTab);
 
 	const DataType * dataType = getTypeNode()->getType();
-	std::string varName = ID()->getName();
+	Ident varName = ID()->getIdent();
 
 	bool validType = true;
 	if (dataType == nullptr){
@@ -106,53 +278,63 @@ bool VarDeclNode::nameAnalysis(SymbolTable * symTab){
 }
 
 bool FnDeclNode::nameAnalysis(SymbolTable * symTab){
-	std::string fnName = this->ID()->getName();
+	bool validHeader = nameAnalysisHeader(symTab);
+	bool validBody = nameAnalysisBody(symTab);
+	return validHeader && validBody;
+}
+
+bool FnDeclNode::nameAnalysisHeader(SymbolTable * symTab){
+	Ident fnName = this->ID()->getIdent();
 
 	bool validRet = myRetType->nameAnalysis(symTab);
 
 	// hold onto the scope of the function.
-	ScopeTable * atFnScope = symTab->getCurrentScope();
+	ScopeTable atFnScope = symTab->getCurrentScope();
 	//Enter a new scope for "within" this function.
-	ScopeTable * inFnScope = symTab->enterScope();
+	ScopeTable inFnScope = symTab->enterScope();
 
 	/*Note that we check for a clash of the function 
 	  name in it's declared scope (e.g. a global
 	  scope for a global function)
 	*/
 	bool validName = true;
-	if (atFnScope->clash(fnName)){
+	if (atFnScope.clash(fnName)){
 		NameErr::multiDecl(ID()->pos()); 
 		validName = false;
 	}
 
 	bool validFormals = true;
-	std::list<const DataType *> * formalTypes = 
-		new std::list<const DataType *>();
+	FnType::Formals formalTypes;
+	formalTypes.reserve(this->myFormals->size());
 	for (auto formal : *(this->myFormals)){
 		validFormals = formal->nameAnalysis(symTab) && validFormals;
 		TypeNode * typeNode = formal->getTypeNode();
 		const DataType * formalType = typeNode->getType();
-		formalTypes->push_back(formalType);
+		formalTypes.push_back(formalType);
 	}
 
 
 	const DataType * retType = this->getRetTypeNode()->getType();
-	FnType * dataType = new FnType(formalTypes, retType);
+	const FnType * dataType = FnType::produce(retType, formalTypes);
 	//Make sure the fnSymbol is in the symbol table before 
 	// analyzing the body, to allow for recursive calls
 	if (validName){
-		atFnScope->addFn(fnName, dataType);
-		SemSymbol * sym = atFnScope->lookup(fnName);
+		atFnScope.addFn(fnName, dataType);
+		SemSymbol * sym = atFnScope.lookup(fnName);
 		//this->myID->attachSymbol(sym);
 	}
 
+	return (validRet && validFormals && validName);
+}
+
+bool FnDeclNode::nameAnalysisBody(SymbolTable * symTab){
 	bool validBody = true;
 	for (auto stmt : *myBody){
 		validBody = stmt->nameAnalysis(symTab) && validBody;
 	}
 
 	symTab->leaveScope();
-	return (validRet && validFormals && validName && validBody);
+	return validBody;
 }
 
 bool BinaryExpNode::nameAnalysis(SymbolTable * symTab){
@@ -230,8 +412,7 @@ bool FalseNode::nameAnalysis(SymbolTable * symTab){
 }
 
 bool IDNode::nameAnalysis(SymbolTable* symTab){
-	std::string myName = this->getName();
-	SemSymbol * sym = symTab->find(myName);
+	SemSymbol * sym = symTab->find(this->getIdent());
 	if (sym == nullptr){
 		return NameErr::undeclID(pos());
 	}
@@ -5,23 +5,39 @@
 
 namespace cminusminus{
 
+class TypeAnalysis;
+
 class NameAnalysis{
 public:
-	static NameAnalysis * build(ProgramNode * astIn){
+	//With more than one worker, the globals are declared first
+	// and the function bodies are then resolved concurrently
+	static NameAnalysis * build(ProgramNode * astIn,
+		size_t workers = 1){
 		NameAnalysis * nameAnalysis = new NameAnalysis;
-		SymbolTable * symTab = new SymbolTable();
-		bool res = astIn->nameAnalysis(symTab);
-		delete symTab;
+		bool res;
+		if (workers > 1){
+			res = analyzeInParallel(astIn, workers);
+		} else {
+			SymbolTable * symTab = new SymbolTable();
+			res = astIn->nameAnalysis(symTab);
+			delete symTab;
+		}
 		if (!res){ return nullptr; }
 
 		nameAnalysis->ast = astIn;
 		return nameAnalysis;
 	}
+	//Resolve names and check types in the same traversal. The
+	// type analysis is handed back through typesOut, to be
+	// finished (see TypeAnalysis::finishFused) when it is needed.
+	static NameAnalysis * buildFused(ProgramNode * astIn,
+		TypeAnalysis ** typesOut);
 	ProgramNode * ast;
 
 private:
 	NameAnalysis(){
 	}
+	static bool analyzeInParallel(ProgramNode * ast, size_t workers);
 };
 
 }
@@ -0,0 +1,381 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+#include "byte_scan.hpp"
+#include "generator.hpp"
+#include "session.hpp"
+#include "stats.hpp"
+
+using namespace cminusminus;
+
+static void usageAndDie(){
+	std::cerr << "Usage: cmmbench [options]\n"
+	<< " [-sizes <list>]: Comma-separated input sizes, with K/M"
+	" suffixes\n  (default 1K,10K,100K,1M,10M,100M)\n"
+	<< " [-reps <n>]: Runs per size; the fastest is reported"
+	" (default 3)\n"
+	<< " [-emit <file>]: Write one generated program and exit\n"
+	<< " [-threads <n>]: Threads for lexing and semantic analysis\n"
+	<< "  (default 1)\n"
+	<< " [-fused]: Resolve names and check types in one traversal\n"
+	<< " [-flat]: Analyze and unparse a flat table of the AST\n"
+	<< " [-saved]: As -flat, but load the table from a file saved\n"
+	<< "  beforehand instead of parsing\n"
+	<< " [-hand-lexer]: Lex with the hand-written scanner\n"
+	<< " [-token-buffer]: Lex into a packed token array, and parse\n"
+	<< "  from that\n"
+	<< " [-lexers]: Only lex, timing the flex scanner and the\n"
+	<< "  hand-written one at each SIMD level on the same input, and\n"
+	<< "  both split across the -threads threads if there are more\n"
+	<< "Program shape:\n"
+	<< " [-globals <n>] [-functions <n>] [-depth <n>] [-stmts <n>]\n"
+	<< " [-expr <n>] [-fanout <n>] [-noptrs] [-seed <n>]\n"
+	<< " [-comments <percent>]: Put a comment line before this share\n"
+	<< "  of the statements (default 0)\n"
+	<< " [-indent <n>]: Indent with n spaces a level rather than tabs\n"
+	<< " [-literals <percent>]: Make this share of the integer terms\n"
+	<< "  literals from the whole int range (default 0)\n"
+	;
+	exit(1);
+}
+
+//Unparsed output goes nowhere, but is still fully formatted
+class NullBuffer : public std::streambuf{
+protected:
+	int overflow(int c) override { return c; }
+	std::streamsize xsputn(const char *, std::streamsize n) override {
+		return n;
+	}
+};
+
+static size_t parseSize(const char * text){
+	char * end = nullptr;
+	double value = strtod(text, &end);
+	if (end == text || value <= 0){ usageAndDie(); }
+	if (*end == 'K' || *end == 'k'){ value *= 1024; }
+	else if (*end == 'M' || *end == 'm'){ value *= 1024 * 1024; }
+	return static_cast<size_t>(value);
+}
+
+static std::vector<size_t> parseSizes(const char * list){
+	std::vector<size_t> sizes;
+	std::string all = list;
+	size_t start = 0;
+	while (start <= all.size()){
+		size_t comma = all.find(',', start);
+		if (comma == std::string::npos){ comma = all.size(); }
+		sizes.push_back(parseSize(all.substr(start, comma - start).c_str()));
+		start = comma + 1;
+	}
+	return sizes;
+}
+
+static size_t argNum(int argc, const char ** argv, int& i){
+	i++;
+	if (i >= argc){ usageAndDie(); }
+	return static_cast<size_t>(atol(argv[i]));
+}
+
+//How the front end is run
+struct RunMode{
+	size_t threads = 1;
+	bool fused = false;
+	bool flat = false;
+	//Load the flat AST from a file saved beforehand
+	bool saved = false;
+	bool handLexer = false;
+	bool tokenBuffer = false;
+};
+
+//The size of the tree of one run
+struct TreeSize{
+	size_t nodes = 0;
+	size_t bytes = 0;
+};
+
+static size_t nodeCount(const Stats& stats){
+	size_t nodes = 0;
+	for (auto& entry : stats.nodesByClass){ nodes += entry.second; }
+	return nodes;
+}
+
+//Lex the whole file, so that the scan is timed on its own
+static void lex(Session& session, const RunMode& mode){
+	if (mode.tokenBuffer){
+		session.tokenBuffer();
+	} else {
+		session.tokens();
+	}
+}
+
+//Run every phase over one file, returning false if any of
+// them fails
+static bool runOnce(const std::string& path, const RunMode& mode,
+	Stats& stats, TreeSize& tree){
+	StatsScope scope(&stats);
+	stats.files++;
+	Session session(path.c_str(), mode.threads);
+	session.setFused(mode.fused);
+	session.setHandLexer(mode.handLexer);
+	session.setTokenBuffer(mode.tokenBuffer);
+	NullBuffer nullBuf;
+	std::ostream nullOut(&nullBuf);
+	if (mode.flat || mode.saved){
+		if (!session.savedAST()){ lex(session, mode); }
+		FlatAST * flat = session.flatAST();
+		if (flat == nullptr){ return false; }
+		tree.nodes = flat->size();
+		tree.bytes = flat->bytes();
+		if (session.flatTypeAnalysis() == nullptr){ return false; }
+		PhaseTimer timer(Stats::UNPARSE);
+		flat->unparse(nullOut);
+		return true;
+	}
+	lex(session, mode);
+	ProgramNode * ast = session.ast();
+	if (ast == nullptr){ return false; }
+	//Tokens are lexed first, so the parse's arena bytes are
+	// those of the tree (and, from a token buffer, of the
+	// tokens the parser kept)
+	tree.nodes = nodeCount(stats);
+	tree.bytes = stats.phases[Stats::PARSE].arenaBytes;
+	if (session.typeAnalysis() == nullptr){ return false; }
+	PhaseTimer timer(Stats::UNPARSE);
+	ast->unparse(nullOut, 0);
+	return true;
+}
+
+//Parse the file at path and save its flat AST to astPath
+static bool saveAST(const std::string& path, const std::string& astPath){
+	Session session(path.c_str());
+	FlatAST * flat = session.flatAST();
+	if (flat == nullptr){ return false; }
+	std::ofstream out(astPath, std::ios::binary);
+	flat->save(out);
+	return out.good();
+}
+
+//The -t output of one scanner over the file at path
+static std::string tokenText(const std::string& path, bool hand,
+	size_t threads = 1){
+	Session session(path.c_str(), threads);
+	session.setHandLexer(hand);
+	std::ostringstream out;
+	session.writeTokens(out);
+	return out.str();
+}
+
+//The best time of lexing the file at path, and the number of
+// tokens
+static double timeLexing(const std::string& path, bool hand, size_t reps,
+	size_t& tokens, size_t threads = 1){
+	double bestMs = 0;
+	for (size_t rep = 0; rep < reps; rep++){
+		Stats stats;
+		StatsScope scope(&stats);
+		Session session(path.c_str(), threads);
+		session.setHandLexer(hand);
+		session.tokens();
+		double ms = stats.phases[Stats::SCAN].wallMs;
+		if (rep == 0 || ms < bestMs){ bestMs = ms; }
+		tokens = stats.tokens;
+	}
+	return bestMs;
+}
+
+static void reportLexing(size_t bytes, const std::string& name, double ms,
+	size_t tokens){
+	double secs = ms / 1000.0;
+	double mb = static_cast<double>(bytes) / (1024 * 1024);
+	char line[160];
+	snprintf(line, sizeof(line), "%12zu %-15s %10.3f %12.2f %14.0f\n",
+		bytes, name.c_str(), ms, mb / secs,
+		static_cast<double>(tokens) / secs);
+	std::cout << line;
+}
+
+//Time the flex scanner and the hand-written one (at each level
+// of ByteScan the CPU supports) over the same file, and both of
+// them again with the file split across threads if there is
+// more than one. Returns false if any of them disagree on the
+// tokens.
+static bool compareLexers(const std::string& path, size_t bytes,
+	size_t reps, size_t threads){
+	size_t tokens = 0;
+	double ms = timeLexing(path, false, reps, tokens);
+	reportLexing(bytes, "lex_flex", ms, tokens);
+	std::string expected = tokenText(path, false);
+	ByteScan::Level chosen = ByteScan::level();
+	bool agree = true;
+	for (int k = 0; k < ByteScan::NUM_LEVELS; k++){
+		ByteScan::Level level = static_cast<ByteScan::Level>(k);
+		if (!ByteScan::supported(level)){ continue; }
+		ByteScan::use(level);
+		ms = timeLexing(path, true, reps, tokens);
+		reportLexing(bytes, std::string("lex_hand_") +
+			ByteScan::levelName(level), ms, tokens);
+		if (tokenText(path, true) != expected){ agree = false; }
+	}
+	ByteScan::use(chosen);
+	if (threads > 1){
+		std::string suffix = "_" + std::to_string(threads) + "t";
+		for (bool hand : { false, true }){
+			ms = timeLexing(path, hand, reps, tokens, threads);
+			reportLexing(bytes, (hand ? "lex_hand" : "lex_flex") + suffix,
+				ms, tokens);
+			if (tokenText(path, hand, threads) != expected){ agree = false; }
+		}
+	}
+	return agree;
+}
+
+static void report(size_t bytes, const Stats& best, const TreeSize& tree){
+	double mb = static_cast<double>(bytes) / (1024 * 1024);
+	double nodes = static_cast<double>(tree.nodes);
+	for (int i = 0; i < Stats::NUM_PHASES; i++){
+		double secs = best.phases[i].wallMs / 1000.0;
+		char line[160];
+		if (secs > 0){
+			snprintf(line, sizeof(line),
+				"%12zu %-15s %10.3f %12.2f %14.0f\n", bytes,
+				Stats::phaseName(i), best.phases[i].wallMs,
+				mb / secs, nodes / secs);
+		} else {
+			snprintf(line, sizeof(line), "%12zu %-15s %10.3f %12s %14s\n",
+				bytes, Stats::phaseName(i), best.phases[i].wallMs,
+				"-", "-");
+		}
+		std::cout << line;
+	}
+	if (nodes > 0){
+		char line[160];
+		snprintf(line, sizeof(line), "%12zu %-15s %10.1f bytes/node\n",
+			bytes, "ast_memory", static_cast<double>(tree.bytes) / nodes);
+		std::cout << line;
+	}
+}
+
+int main(int argc, const char ** argv){
+	ProgramShape shape;
+	std::vector<size_t> sizes = parseSizes("1K,10K,100K,1M,10M,100M");
+	size_t reps = 3;
+	RunMode mode;
+	const char * emitPath = nullptr;
+	bool lexers = false;
+
+	for (int i = 1; i < argc; i++){
+		const char * arg = argv[i];
+		if (strcmp(arg, "-sizes") == 0){
+			i++;
+			if (i >= argc){ usageAndDie(); }
+			sizes = parseSizes(argv[i]);
+		} else if (strcmp(arg, "-reps") == 0){
+			reps = argNum(argc, argv, i);
+		} else if (strcmp(arg, "-emit") == 0){
+			i++;
+			if (i >= argc){ usageAndDie(); }
+			emitPath = argv[i];
+		} else if (strcmp(arg, "-threads") == 0){
+			mode.threads = argNum(argc, argv, i);
+		} else if (strcmp(arg, "-fused") == 0){
+			mode.fused = true;
+		} else if (strcmp(arg, "-flat") == 0){
+			mode.flat = true;
+		} else if (strcmp(arg, "-saved") == 0){
+			mode.saved = true;
+		} else if (strcmp(arg, "-hand-lexer") == 0){
+			mode.handLexer = true;
+		} else if (strcmp(arg, "-token-buffer") == 0){
+			mode.tokenBuffer = true;
+		} else if (strcmp(arg, "-lexers") == 0){
+			lexers = true;
+		} else if (strcmp(arg, "-globals") == 0){
+			shape.globals = argNum(argc, argv, i);
+		} else if (strcmp(arg, "-functions") == 0){
+			shape.functions = argNum(argc, argv, i);
+		} else if (strcmp(arg, "-depth") == 0){
+			shape.nestingDepth = argNum(argc, argv, i);
+		} else if (strcmp(arg, "-stmts") == 0){
+			shape.blockStmts = argNum(argc, argv, i);
+		} else if (strcmp(arg, "-expr") == 0){
+			shape.exprDepth = argNum(argc, argv, i);
+		} else if (strcmp(arg, "-fanout") == 0){
+			shape.callFanOut = argNum(argc, argv, i);
+		} else if (strcmp(arg, "-comments") == 0){
+			shape.comments = argNum(argc, argv, i);
+		} else if (strcmp(arg, "-indent") == 0){
+			shape.indentSpaces = argNum(argc, argv, i);
+		} else if (strcmp(arg, "-literals") == 0){
+			shape.literals = argNum(argc, argv, i);
+		} else if (strcmp(arg, "-noptrs") == 0){
+			shape.pointers = false;
+		} else if (strcmp(arg, "-seed") == 0){
+			shape.seed = static_cast<unsigned>(argNum(argc, argv, i));
+		} else {
+			std::cerr << "Unrecognized argument: " << arg << std::endl;
+			usageAndDie();
+		}
+	}
+	if (reps == 0 || mode.threads == 0 || sizes.empty()){ usageAndDie(); }
+
+	if (emitPath != nullptr){
+		ProgramGenerator gen(shape);
+		std::ofstream out(emitPath);
+		out << gen.generate(sizes.front());
+		return out.good() ? 0 : 1;
+	}
+
+	char line[160];
+	snprintf(line, sizeof(line), "%12s %-15s %10s %12s %14s\n",
+		"bytes", "phase", "ms", "MB/s", lexers ? "tokens/s" : "nodes/s");
+	std::cout << line;
+	const std::string path = "cmmbench.tmp.cmm";
+	const std::string astPath = "cmmbench.tmp.ast";
+	for (size_t size : sizes){
+		ProgramGenerator gen(shape);
+		std::string program = gen.generate(size);
+		{
+			std::ofstream out(path);
+			out << program;
+		}
+		if (lexers){
+			if (!compareLexers(path, program.size(), reps, mode.threads)){
+				std::cerr << "The scanners disagree on " << path << std::endl;
+				return 1;
+			}
+			continue;
+		}
+		if (mode.saved && !saveAST(path, astPath)){
+			std::cerr << "Could not save the AST of " << path << std::endl;
+			return 1;
+		}
+		//Keep the fastest run of each phase
+		Stats best;
+		TreeSize tree;
+		for (size_t rep = 0; rep < reps; rep++){
+			Stats stats;
+			if (!runOnce(mode.saved ? astPath : path, mode, stats, tree)){
+				std::cerr << "Generated program failed to compile;"
+					" it is in " << path << std::endl;
+				return 1;
+			}
+			if (rep == 0){
+				best = stats;
+				continue;
+			}
+			for (int i = 0; i < Stats::NUM_PHASES; i++){
+				if (stats.phases[i].wallMs < best.phases[i].wallMs){
+					best.phases[i] = stats.phases[i];
+				}
+			}
+		}
+		report(program.size(), best, tree);
+	}
+	remove(path.c_str());
+	if (mode.saved){ remove(astPath.c_str()); }
+	return 0;
+}
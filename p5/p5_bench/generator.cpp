@@ -0,0 +1,264 @@
+#include <climits>
+#include "generator.hpp"
+
+namespace cminusminus{
+
+static const char * const INT_OPS[] = { " + ", " - ", " * ", " / " };
+static const char * const REL_OPS[] = {
+	" < ", " <= ", " > ", " >= ", " == ", " != " };
+
+static const char * const COMMENTS[] = {
+	"# keep the running total in range before it is written out",
+	"# TODO: check this against the values read in the last pass",
+	"# the pointer is only ever set to one of the globals",
+	"# loop until the condition settles; it always does",
+};
+
+//Locals declared at the top of every generated function
+static const size_t INT_LOCALS = 4;
+
+ProgramGenerator::ProgramGenerator(const ProgramShape& shapeIn)
+: shape(shapeIn), rng(shapeIn.seed){
+}
+
+size_t ProgramGenerator::pick(size_t n){
+	return static_cast<size_t>(rng() % n);
+}
+
+bool ProgramGenerator::chance(size_t percent){
+	return pick(100) < percent;
+}
+
+std::string ProgramGenerator::generate(size_t targetBytes){
+	std::string out;
+	out.reserve(targetBytes + 4096);
+	out += "# generated by cmmbench\n";
+
+	globalInts.clear();
+	globalBools.clear();
+	globalPtrs.clear();
+	arities.clear();
+	for (size_t i = 0; i < shape.globals; i++){
+		std::string name = "g" + std::to_string(i);
+		size_t kind = shape.pointers ? i % 3 : i % 2;
+		if (kind == 0){
+			out += "int " + name + ";\n";
+			globalInts.push_back(name);
+		} else if (kind == 1){
+			out += "bool " + name + ";\n";
+			globalBools.push_back(name);
+		} else {
+			out += "ptr int " + name + ";\n";
+			globalPtrs.push_back(name);
+		}
+	}
+
+	size_t index = 0;
+	while (true){
+		if (shape.functions > 0){
+			if (index >= shape.functions){ break; }
+		} else if (out.size() >= targetBytes){
+			break;
+		}
+		genFunction(out, index);
+		index++;
+	}
+
+	out += "int main(){\n\tint r;\n";
+	if (!arities.empty()){
+		out += "\tr = ";
+		intVars.assign(1, "r");
+		boolVars.clear();
+		ptrVars.clear();
+		genCall(out);
+		out += ";\n";
+	}
+	out += "\treturn 0;\n}\n";
+	return out;
+}
+
+void ProgramGenerator::genFunction(std::string& out, size_t index){
+	size_t arity = 1 + pick(3);
+	intVars = globalInts;
+	boolVars = globalBools;
+	ptrVars = globalPtrs;
+
+	out += "int f" + std::to_string(index) + "(";
+	for (size_t i = 0; i < arity; i++){
+		std::string name = "a" + std::to_string(i);
+		if (i > 0){ out += ", "; }
+		out += "int " + name;
+		intVars.push_back(name);
+	}
+	out += "){\n";
+	for (size_t i = 0; i < INT_LOCALS; i++){
+		std::string name = "v" + std::to_string(i);
+		out += "\tint " + name + ";\n";
+		intVars.push_back(name);
+	}
+	out += "\tbool b0;\n";
+	boolVars.push_back("b0");
+	if (shape.pointers){
+		out += "\tptr int p0;\n\tp0 = &v0;\n";
+		ptrVars.push_back("p0");
+	}
+
+	for (size_t i = 0; i < shape.callFanOut && !arities.empty(); i++){
+		out += "\tv" + std::to_string(pick(INT_LOCALS)) + " = ";
+		genCall(out);
+		out += ";\n";
+	}
+	genBlock(out, shape.nestingDepth, 1);
+	out += "\treturn ";
+	genIntExp(out, shape.exprDepth);
+	out += ";\n}\n";
+
+	arities.push_back(arity);
+}
+
+void ProgramGenerator::genBlock(std::string& out, size_t depth,
+	size_t indent){
+	for (size_t i = 0; i < shape.blockStmts; i++){
+		genStmt(out, depth, indent);
+	}
+}
+
+void ProgramGenerator::genStmt(std::string& out, size_t depth,
+	size_t indent){
+	std::string tabs = shape.indentSpaces == 0 ? std::string(indent, '\t')
+		: std::string(indent * shape.indentSpaces, ' ');
+	//Only draw for comments when asked for them, so that the
+	// programs of a seed do not change otherwise
+	if (shape.comments > 0 && chance(shape.comments)){
+		out += tabs;
+		out += COMMENTS[pick(sizeof(COMMENTS) / sizeof(COMMENTS[0]))];
+		out += "\n";
+	}
+	out += tabs;
+	//Compound statements only while there is depth to spare,
+	// and then for about a third of the statements
+	if (depth > 0 && chance(35)){
+		size_t which = pick(3);
+		out += which == 0 ? "while (" : "if (";
+		genBoolExp(out, shape.exprDepth);
+		out += "){\n";
+		genBlock(out, depth - 1, indent + 1);
+		out += tabs + "}";
+		if (which == 2){
+			out += " else {\n";
+			genBlock(out, depth - 1, indent + 1);
+			out += tabs + "}";
+		}
+		out += "\n";
+		return;
+	}
+
+	size_t which = pick(10);
+	if (which < 4){
+		genIntLVal(out);
+		out += " = ";
+		genIntExp(out, shape.exprDepth);
+	} else if (which == 4){
+		out += boolVars[pick(boolVars.size())] + " = ";
+		genBoolExp(out, shape.exprDepth);
+	} else if (which == 5){
+		out += "write ";
+		genIntExp(out, shape.exprDepth);
+	} else if (which == 6){
+		out += "read ";
+		genIntLVal(out);
+	} else if (which == 7){
+		genIntLVal(out);
+		out += chance(50) ? "++" : "--";
+	} else if (which == 8 && !arities.empty()){
+		genCall(out);
+	} else if (shape.pointers && !ptrVars.empty()){
+		out += ptrVars[pick(ptrVars.size())] + " = &"
+			+ intVars[pick(intVars.size())];
+	} else {
+		out += "write \"s" + std::to_string(pick(1000)) + "\\n\"";
+	}
+	out += ";\n";
+}
+
+void ProgramGenerator::genCall(std::string& out){
+	size_t callee = pick(arities.size());
+	out += "f" + std::to_string(callee) + "(";
+	for (size_t i = 0; i < arities[callee]; i++){
+		if (i > 0){ out += ", "; }
+		genIntExp(out, shape.exprDepth > 0 ? shape.exprDepth - 1 : 0);
+	}
+	out += ")";
+}
+
+void ProgramGenerator::genIntExp(std::string& out, size_t depth){
+	if (depth == 0 || chance(20)){
+		genIntTerm(out);
+		return;
+	}
+	bool parens = chance(50);
+	if (parens){ out += "("; }
+	genIntExp(out, depth - 1);
+	out += INT_OPS[pick(4)];
+	genIntExp(out, depth - 1);
+	if (parens){ out += ")"; }
+}
+
+void ProgramGenerator::genBoolExp(std::string& out, size_t depth){
+	if (depth == 0){
+		size_t which = pick(3);
+		if (which == 0){
+			out += boolVars[pick(boolVars.size())];
+		} else if (which == 1){
+			out += chance(50) ? "true" : "false";
+		} else {
+			out += "!" + boolVars[pick(boolVars.size())];
+		}
+		return;
+	}
+	//Comparisons do not associate, so they are always
+	// parenthesized
+	if (chance(60)){
+		out += "(";
+		genIntExp(out, depth - 1);
+		out += REL_OPS[pick(6)];
+		genIntExp(out, depth - 1);
+		out += ")";
+		return;
+	}
+	//Boolean operands are combined with == and != rather than
+	// and/or: type analysis does not yet give and/or nodes a
+	// type when their operands are fine
+	out += "(";
+	genBoolExp(out, depth - 1);
+	out += chance(50) ? " == " : " != ";
+	genBoolExp(out, depth - 1);
+	out += ")";
+}
+
+void ProgramGenerator::genIntTerm(std::string& out){
+	if (shape.literals > 0 && chance(shape.literals)){
+		out += std::to_string(pick(INT_MAX));
+		return;
+	}
+	size_t which = pick(10);
+	if (which < 4){
+		out += std::to_string(pick(100000));
+	} else if (which == 4){
+		out += "-" + std::to_string(pick(100));
+	} else if (which == 5 && shape.pointers && !ptrVars.empty()){
+		out += "@" + ptrVars[pick(ptrVars.size())];
+	} else {
+		out += intVars[pick(intVars.size())];
+	}
+}
+
+void ProgramGenerator::genIntLVal(std::string& out){
+	if (shape.pointers && !ptrVars.empty() && chance(15)){
+		out += "@" + ptrVars[pick(ptrVars.size())];
+	} else {
+		out += intVars[pick(intVars.size())];
+	}
+}
+
+}
@@ -0,0 +1,76 @@
+#ifndef CMINUSMINUS_BENCH_GENERATOR_HPP
+#define CMINUSMINUS_BENCH_GENERATOR_HPP
+
+#include <random>
+#include <string>
+#include <vector>
+
+namespace cminusminus{
+
+//The knobs that control what a generated program looks like
+struct ProgramShape{
+	//Global variables declared before the first function
+	size_t globals = 32;
+	//Functions to generate. 0 means "as many as it takes to
+	// reach the requested size"
+	size_t functions = 0;
+	//How deeply if and while statements nest inside a body
+	size_t nestingDepth = 3;
+	//Statements in each block
+	size_t blockStmts = 4;
+	//How deeply binary operators nest inside an expression
+	size_t exprDepth = 3;
+	//Calls to earlier functions made by each function
+	size_t callFanOut = 2;
+	//Whether to declare, take the address of and dereference
+	// pointer variables
+	bool pointers = true;
+	//Percent of statements with a comment line before them
+	size_t comments = 0;
+	//Spaces per level of indentation; 0 indents with tabs
+	size_t indentSpaces = 0;
+	//Percent of integer terms that are literals drawn from the
+	// whole int range, as in tables of constants; 0 keeps the
+	// usual mix of terms
+	size_t literals = 0;
+	unsigned seed = 1;
+};
+
+//Writes random, well-typed C-- programs of a given shape. Every
+// construct it emits comes from the grammar in cminusminus.yy,
+// and every program passes name and type analysis, so that a
+// benchmark exercises each phase of the front end.
+class ProgramGenerator{
+public:
+	ProgramGenerator(const ProgramShape& shapeIn);
+	//A program of at least targetBytes bytes (or of exactly
+	// shape.functions functions, if that is set)
+	std::string generate(size_t targetBytes);
+private:
+	void genFunction(std::string& out, size_t index);
+	void genBlock(std::string& out, size_t depth, size_t indent);
+	void genStmt(std::string& out, size_t depth, size_t indent);
+	void genCall(std::string& out);
+	void genIntExp(std::string& out, size_t depth);
+	void genBoolExp(std::string& out, size_t depth);
+	void genIntTerm(std::string& out);
+	void genIntLVal(std::string& out);
+	size_t pick(size_t n);
+	bool chance(size_t percent);
+
+	ProgramShape shape;
+	std::mt19937 rng;
+	//The names in scope in the function being generated
+	std::vector<std::string> intVars;
+	std::vector<std::string> boolVars;
+	std::vector<std::string> ptrVars;
+	std::vector<std::string> globalInts;
+	std::vector<std::string> globalBools;
+	std::vector<std::string> globalPtrs;
+	//The arity of every function generated so far
+	std::vector<size_t> arities;
+};
+
+}
+
+#endif
@@ -0,0 +1,16 @@
+#include "position.hpp"
+#include "source_buffer.hpp"
+
+namespace cminusminus{
+
+std::string Position::lineCol(uint32_t offset) const{
+	size_t line = 0;
+	size_t col = 0;
+	SourceBuffer * source = SourceBuffer::lookup(myFile);
+	if (source != nullptr){
+		source->lineCol(offset, line, col);
+	}
+	return std::to_string(line) + "," + std::to_string(col);
+}
+
+}
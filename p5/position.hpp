@@ -1,48 +1,49 @@
 #ifndef CMINUSMINUS_POSITION_H
 #define CMINUSMINUS_POSITION_H
 
+#include <cstdint>
 #include <string>
 
 namespace cminusminus{
 
+//A span of source text, stored as the id of the SourceBuffer it
+// came from and a pair of 32-bit byte offsets into it. Lines
+// and columns are not kept; they are worked out from the
+// buffer's line index only when a position is printed. The
+// default Position belongs to no file and prints as [0,0].
 class Position{
-public: 
-	Position(size_t lineI, size_t colI, size_t lineE, size_t colE)
-	: myLineI(lineI), myColI(colI), myLineE(lineE), myColE(colE){
+public:
+	Position() : myFile(0), myStart(0), myEnd(0){ }
+	Position(uint32_t fileIn, size_t startIn, size_t endIn)
+	: myFile(fileIn),
+	  myStart(static_cast<uint32_t>(startIn)),
+	  myEnd(static_cast<uint32_t>(endIn)){
 	}
-	Position(Position * start, Position * end)
-	: myLineI(start->myLineI), myColI(start->myColI),
-	  myLineE(end->myLineE),myColE(end->myColE){
+	Position(const Position * start, const Position * end)
+	: myFile(start->myFile), myStart(start->myStart),
+	  myEnd(end->myEnd){
 	}
-	virtual void expand(Position * start, Position * end){
-	  myLineI = start->myLineI;
-	  myColI = start->myColI;
-	  myLineE = end->myLineE;
-	  myColE = end->myColE;
+	void expand(const Position * start, const Position * end){
+	  myFile = start->myFile;
+	  myStart = start->myStart;
+	  myEnd = end->myEnd;
 	}
-	virtual std::string begin() const{
-		std::string result = "[" 
-		+ std::to_string(myLineI)
-		+ "," 
-		+ std::to_string(myColI)
-		+ "]";
-		return result;
+	std::string begin() const{
+		return "[" + lineCol(myStart) + "]";
 	}
-	virtual std::string span() const{
-		std::string result = begin()
-		+ "-[" 
-		+ std::to_string(myLineE)
-		+ "," 
-		+ std::to_string(myColE)
-		+ "]";
-		return result;
+	std::string span() const{
+		return begin() + "-[" + lineCol(myEnd) + "]";
 	}
+	uint32_t file() const { return myFile; }
+	uint32_t startOffset() const { return myStart; }
+	uint32_t endOffset() const { return myEnd; }
 private:
-	size_t myLineI;
-	size_t myColI;
-	size_t myLineE;
-	size_t myColE;
+	//"line,col" for an offset in this position's file
+	std::string lineCol(uint32_t offset) const;
 
+	uint32_t myFile;
+	uint32_t myStart;
+	uint32_t myEnd;
 };
 
 }
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 #include "scanner.hpp"
 
@@ -6,20 +8,75 @@ using namespace cminusminus;
 using TokenKind = cminusminus::Parser::token;
 using Lexeme = cminusminus::Parser::semantic_type;
 
-void Scanner::outputTokens(std::ostream& outstream){
+void Scanner::collectTokens(std::vector<Token *>& out,
+	HeldDiagnostics& held){
 	Lexeme lex;
+	Diagnostics diags;
+	DiagnosticsScope scope(&diags);
 	int tokenKind;
 	while(true){
-		tokenKind = this->yylex(&lex);
+		size_t index = out.size();
+		tokenKind = this->lex(&lex);
+		if (diags.pending()){ held.hold(index, diags); }
 		if (tokenKind == TokenKind::END){
-			outstream << "EOF" 
-			  << " [" << this->lineNum 
-			  << "," << this->colNum << "]"
-			  << std::endl;
+			Position pos(source->id(), srcOffset, srcOffset);
+			out.push_back(new Token(pos, TokenKind::END));
 			return;
 		} else {
-			outstream << lex.lexeme->toString()
-			  << std::endl;
+			out.push_back(lex.lexeme);
 		}
 	}
 }
+
+void Scanner::collectTokens(TokenBuffer& out){
+	Lexeme lex;
+	Diagnostics diags;
+	DiagnosticsScope scope(&diags);
+	packInto = &out;
+	int tokenKind;
+	do {
+		size_t index = out.size();
+		tokenKind = this->lex(&lex);
+		if (diags.pending()){ out.diagnostics().hold(index, diags); }
+	} while (tokenKind != TokenKind::END);
+	packInto = nullptr;
+	out.add(TokenKind::END, srcOffset, srcOffset);
+}
+
+int Scanner::nextToken(Lexeme * const lval){
+	if (replayPacked != nullptr){
+		//Keep handing back the END token once it is reached,
+		// passing on what was held for it only the first time
+		size_t last = replayPacked->size() - 1;
+		size_t index = std::min(replayIdx, last);
+		if (replayIdx <= last){
+			replayPacked->diagnostics().pass(index);
+			replayIdx++;
+		}
+		lval->lexeme = replayPacked->token(index, source);
+		return (*replayPacked)[index].kind;
+	}
+	if (replayTokens == nullptr){
+		return this->lex(lval);
+	}
+	//As above
+	size_t last = replayTokens->size() - 1;
+	size_t index = std::min(replayIdx, last);
+	if (replayIdx <= last){
+		if (replayHeld != nullptr){ replayHeld->pass(index); }
+		replayIdx++;
+	}
+	Token * tok = (*replayTokens)[index];
+	lval->lexeme = tok;
+	return tok->kind();
+}
+
+int Scanner::LexerInput(char * buf, int maxSize){
+	if (source == nullptr || maxSize <= 0){ return 0; }
+	size_t remaining = limit - readOffset;
+	size_t len = static_cast<size_t>(maxSize);
+	if (remaining < len){ len = remaining; }
+	memcpy(buf, source->data() + readOffset, len);
+	readOffset += len;
+	return static_cast<int>(len);
+}
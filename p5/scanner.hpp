@@ -5,8 +5,12 @@
 #include <FlexLexer.h>
 #endif
 
+#include <climits>
+#include <vector>
 #include "grammar.hh"
 #include "errors.hpp"
+#include "source_buffer.hpp"
+#include "token_buffer.hpp"
 
 using TokenKind = cminusminus::Parser::token;
 
@@ -15,12 +19,57 @@ namespace cminusminus{
 class Scanner : public yyFlexLexer{
 public:
    
+   //Lex a source buffer in place. Token text points into the
+   // buffer, so it must outlive the tokens.
+   Scanner(SourceBuffer * sourceIn) : yyFlexLexer(nullptr)
+   {
+	source = sourceIn;
+	limit = source->size();
+   };
+
+   //Lex only the bytes of the buffer from begin up to end,
+   // which must each be the start of a line (or the end of the
+   // buffer). Positions are still offsets into the whole buffer.
+   Scanner(SourceBuffer * sourceIn, size_t beginIn, size_t endIn)
+   : yyFlexLexer(nullptr)
+   {
+	source = sourceIn;
+	readOffset = beginIn;
+	tokOffset = beginIn;
+	srcOffset = beginIn;
+	limit = endIn;
+   };
+
+   //Lex a stream. The stream is read into a buffer owned by
+   // the scanner, so tokens are only valid while it lives.
    Scanner(std::istream *in) : yyFlexLexer(in)
    {
-	lineNum = 1;
-	colNum = 1;
+	ownedSource = SourceBuffer::read(*in);
+	source = ownedSource;
+	limit = source->size();
+   };
+
+   //Build a scanner that hands back an already-lexed token
+   // stream (as produced by collectTokens) instead of reading
+   // the input a second time, passing on what was held with
+   // each token as the parser takes it
+   Scanner(const std::vector<Token *> * tokensIn,
+	const HeldDiagnostics * heldIn) : yyFlexLexer(nullptr)
+   {
+	replayTokens = tokensIn;
+	replayHeld = heldIn;
+   };
+
+   //Likewise, but from a packed stream (as produced by the
+   // collectTokens that fills a TokenBuffer) lexed from source
+   Scanner(const TokenBuffer * packedIn, SourceBuffer * sourceIn)
+   : yyFlexLexer(nullptr)
+   {
+	replayPacked = packedIn;
+	source = sourceIn;
    };
    virtual ~Scanner() {
+	delete ownedSource;
    };
 
    //get rid of override virtual function warning
@@ -29,16 +78,102 @@ public:
    // YY_DECL defined in the flex cminusminus.l
    virtual int yylex( cminusminus::Parser::semantic_type * const lval);
 
+   //The hand-written scanner (see hand_scanner.cpp), which
+   // gives the same tokens and errors as yylex
+   int handLex(cminusminus::Parser::semantic_type * const lval);
+   //Lex with handLex rather than the flex scanner
+   void setHandWritten(bool handIn){ handWritten = handIn; }
+
+   //The parser pulls its tokens through here, so that it can
+   // consume either the live input or a replayed token stream
+   int nextToken(cminusminus::Parser::semantic_type * const lval);
+
+   //Each of the make functions hands back the current match as
+   // a token, either packed into the buffer being filled or as
+   // a new Token in yylval
    int makeBareToken(int tagIn){
-	size_t len = static_cast<size_t>(yyleng);
-	Position * pos = new Position(
-	  this->lineNum, this->colNum,
-	  this->lineNum, this->colNum+len);
-        this->yylval->lexeme = new Token(pos, tagIn);
-        colNum += len;
+	if (packInto != nullptr){
+		packInto->add(tagIn, tokOffset, srcOffset);
+		return tagIn;
+	}
+        this->yylval->lexeme = new Token(tokenPos(), tagIn);
         return tagIn;
    }
 
+   int makeIDToken(Ident spelling){
+	if (packInto != nullptr){
+		packInto->addID(tokOffset, srcOffset, spelling);
+	} else {
+		yylval->transToken = new IDToken(tokenPos(), spelling);
+	}
+	return TokenKind::ID;
+   }
+
+   //The literal's text, quotes and all, is the whole match
+   int makeStrToken(){
+	if (packInto != nullptr){
+		packInto->add(TokenKind::STRLITERAL, tokOffset, srcOffset);
+	} else {
+		yylval->transToken = new StrToken(tokenPos(), tokenText(),
+			srcOffset - tokOffset);
+	}
+	return TokenKind::STRLITERAL;
+   }
+
+
+   //Make the token for a run of numDigits digits at the start
+   // of the current match, which is an int literal or (with
+   // its trailing S) a short literal. A value too large for its
+   // type is reported and taken as 0.
+   int makeIntLit(size_t numDigits){
+	int value;
+	if (!decimalValue(tokenText(), numDigits, INT_MAX, value)){
+		Position pos = tokenPos();
+		errIntOverflow(&pos);
+		value = 0;
+	}
+	if (packInto != nullptr){
+		packInto->add(TokenKind::INTLITERAL, tokOffset, srcOffset, value);
+	} else {
+		yylval->transToken = new IntLitToken(tokenPos(), value);
+	}
+	return TokenKind::INTLITERAL;
+   }
+   int makeShortLit(size_t numDigits){
+	int value;
+	if (!decimalValue(tokenText(), numDigits, SHRT_MAX, value)){
+		Position pos = tokenPos();
+		errShortOverflow(&pos);
+		value = 0;
+	}
+	if (packInto != nullptr){
+		packInto->add(TokenKind::SHORTLITERAL, tokOffset, srcOffset, value);
+	} else {
+		yylval->transToken = new ShortLitToken(tokenPos(), value);
+	}
+	return TokenKind::SHORTLITERAL;
+   }
+
+   //The value of len decimal digits, found in one pass without
+   // copying them. Returns false if it would exceed max.
+   static bool decimalValue(const char * digits, size_t len, int max,
+	int& value){
+	int result = 0;
+	for (size_t k = 0; k < len; k++){
+		int digit = digits[k] - '0';
+		if (result > (max - digit) / 10){ return false; }
+		result = result * 10 + digit;
+	}
+	value = result;
+	return true;
+   }
+
+   //The position of the current match. Only byte offsets are
+   // recorded; lines and columns are found when it is printed.
+   Position tokenPos() const {
+	return Position(source->id(), tokOffset, srcOffset);
+   }
+
    void errIllegal(Position * pos, std::string match){
 	cminusminus::Report::fatal(pos, "Illegal character "
 		+ match);
@@ -89,12 +224,51 @@ public:
 
    static std::string tokenKindString(int tokenKind);
 
-   void outputTokens(std::ostream& outstream);
+   //The text of the current match, in the source buffer
+   // rather than in flex's own copy of it
+   const char * tokenText() const {
+	return source->data() + tokOffset;
+   }
+
+   //Lex the entire input, appending each token to out. The
+   // stream always ends with an END token marking the EOF
+   // position. What is reported along the way goes to held,
+   // with the index of the token it came before.
+   void collectTokens(std::vector<Token *>& out, HeldDiagnostics& held);
+   //Likewise, but packed into out without making Token objects,
+   // holding what is reported in out's diagnostics
+   void collectTokens(TokenBuffer& out);
+
+protected:
+   //Feed flex straight from the source buffer instead of
+   // going through an istream
+   virtual int LexerInput(char * buf, int maxSize) override;
 
 private:
+   int lex(cminusminus::Parser::semantic_type * const lval){
+	return handWritten ? handLex(lval) : yylex(lval);
+   }
+   int handWord();
+   int handNumber();
+   bool handString();
+
    cminusminus::Parser::semantic_type *yylval = nullptr;
-   size_t lineNum;
-   size_t colNum;
+   SourceBuffer * source = nullptr;
+   SourceBuffer * ownedSource = nullptr;
+   //How far flex has read, and where the current match
+   // starts and ends, as offsets into the source buffer
+   size_t readOffset = 0;
+   size_t tokOffset = 0;
+   size_t srcOffset = 0;
+   //Where lexing stops, as an offset into the source buffer
+   size_t limit = 0;
+   const std::vector<Token *> * replayTokens = nullptr;
+   const HeldDiagnostics * replayHeld = nullptr;
+   const TokenBuffer * replayPacked = nullptr;
+   size_t replayIdx = 0;
+   //The buffer that collectTokens is packing tokens into
+   TokenBuffer * packInto = nullptr;
+   bool handWritten = false;
 };
 
 } /* end namespace */
@@ -0,0 +1,301 @@
+#include <algorithm>
+#include <exception>
+#include "session.hpp"
+#include "byte_scan.hpp"
+#include "diagnostics.hpp"
+#include "scanner.hpp"
+#include "worker_pool.hpp"
+
+namespace cminusminus{
+
+//Files are only split for lexing into pieces of at least this
+// size, so that small ones are not worth the threads
+static const size_t MIN_LEX_CHUNK = 1024 * 1024;
+
+Session::Session(const char * inPathIn, size_t threadsIn,
+	SourceBuffer * sourceIn)
+: inPath(inPathIn), myThreads(threadsIn), mySource(sourceIn){
+}
+
+Session::~Session(){
+	delete myFlatTypes;
+	delete myFlatNames;
+	delete myFlatAST;
+	delete myTypeAnalysis;
+	delete myFusedTypes;
+	delete myNameAnalysis;
+	delete mySource;
+}
+
+SourceBuffer * Session::source(){
+	if (mySource != nullptr){ return mySource; }
+	mySource = SourceBuffer::map(inPath.c_str());
+	if (mySource == nullptr){
+		std::string msg = "Bad input stream ";
+		msg += inPath;
+		throw new UserError(msg.c_str());
+	}
+	return mySource;
+}
+
+//Saved ASTs have no tokens or pointer AST to give
+void Session::checkSource(){
+	if (savedAST()){
+		std::string msg = inPath;
+		msg += " is a saved AST, which can only be used with -flat";
+		throw new UserError(msg.c_str());
+	}
+}
+
+const std::vector<Token *> * Session::tokens(){
+	lexTokens();
+	//Whoever wants the whole stream gets every error in it
+	myTokenDiags.passAll();
+	return &myTokens;
+}
+
+void Session::lexTokens(){
+	if (lexed){ return; }
+	checkSource();
+	lexed = true;
+
+	ArenaScope scope(&myArena);
+	PhaseTimer timer(Stats::SCAN, &myArena);
+	if (splitLexing()){
+		lexInParallel(false);
+	} else {
+		Scanner scanner(source());
+		scanner.setHandWritten(handLexer);
+		scanner.collectTokens(myTokens, myTokenDiags);
+	}
+	if (Stats * stats = Stats::current()){ stats->tokens += myTokens.size(); }
+}
+
+const TokenBuffer * Session::tokenBuffer(){
+	if (buffered){ return &myTokenBuffer; }
+	checkSource();
+	buffered = true;
+
+	PhaseTimer timer(Stats::SCAN, &myArena);
+	if (splitLexing()){
+		lexInParallel(true);
+	} else {
+		Scanner scanner(source());
+		scanner.setHandWritten(handLexer);
+		scanner.collectTokens(myTokenBuffer);
+	}
+	if (Stats * stats = Stats::current()){
+		stats->tokens += myTokenBuffer.size();
+	}
+	return &myTokenBuffer;
+}
+
+bool Session::splitLexing(){
+	return myThreads > 1 && source()->size() >= 2 * MIN_LEX_CHUNK;
+}
+
+//The tokens and diagnostics of one piece of the input
+struct LexRun{
+	size_t begin = 0;
+	size_t end = 0;
+	Arena arena;
+	std::vector<Token *> tokens;
+	HeldDiagnostics held;
+	TokenBuffer buffer;
+	Stats stats;
+	std::exception_ptr failure;
+};
+
+//No token spans a newline (strings and comments both stop at
+// one), so the input can be cut just after newlines and each
+// piece lexed on its own. Each piece gets its own arena, and
+// holds its own diagnostics with its tokens. The results are
+// put back together in order, so that the tokens and errors
+// are the same as those of lexing the whole input at once. With toBuffer set, the
+// tokens are packed into myTokenBuffer rather than myTokens.
+void Session::lexInParallel(bool toBuffer){
+	SourceBuffer * src = source();
+	const char * text = src->data();
+	const size_t size = src->size();
+	size_t numRuns = std::min(myThreads, size / MIN_LEX_CHUNK);
+	std::vector<LexRun> runs(numRuns);
+	size_t begin = 0;
+	for (size_t r = 0; r < numRuns; r++){
+		size_t end = size;
+		if (r + 1 < numRuns){
+			size_t cut = std::max(begin, size / numRuns * (r + 1));
+			end = cut + ByteScan::lineEnd(text + cut, size - cut);
+			if (end < size){ end++; }
+		}
+		runs[r].begin = begin;
+		runs[r].end = end;
+		begin = end;
+	}
+	Stats * stats = Stats::current();
+	{
+		WorkerPool pool(numRuns);
+		for (size_t r = 0; r < numRuns; r++){
+			pool.submit([&, r]{
+				LexRun& run = runs[r];
+				StatsScope statsScope(stats == nullptr ? nullptr : &run.stats);
+				WorkerTimer timer(Stats::SCAN);
+				ArenaScope arenaScope(&run.arena);
+				try {
+					Scanner scanner(src, run.begin, run.end);
+					scanner.setHandWritten(handLexer);
+					if (toBuffer){
+						scanner.collectTokens(run.buffer);
+					} else {
+						scanner.collectTokens(run.tokens, run.held);
+					}
+				} catch (...) {
+					run.failure = std::current_exception();
+				}
+			});
+		}
+		pool.wait();
+	}
+
+	//Every piece but the last ends in an END token that is not
+	// the end of the input
+	for (size_t r = 0; r < numRuns; r++){
+		LexRun& run = runs[r];
+		myArena.adopt(run.arena);
+		if (stats != nullptr){ stats->merge(run.stats); }
+		if (run.failure){ std::rethrow_exception(run.failure); }
+		size_t drop = r + 1 < numRuns ? 1 : 0;
+		if (toBuffer){
+			myTokenBuffer.append(run.buffer, drop);
+			continue;
+		}
+		myTokenDiags.append(run.held, myTokens.size());
+		size_t keep = run.tokens.size() - drop;
+		myTokens.insert(myTokens.end(), run.tokens.begin(),
+			run.tokens.begin() + static_cast<std::ptrdiff_t>(keep));
+	}
+}
+
+ProgramNode * Session::ast(){
+	if (parsed){ return myAST; }
+	checkSource();
+	parsed = true;
+
+	//When timing the phases, lex up front so that scanning is
+	// not charged to the parser. Each lexical error is held
+	// until the parser takes the token after it, so the errors
+	// are the same as without the timing.
+	Stats * stats = Stats::current();
+	if (stats != nullptr){
+		if (useTokenBuffer){
+			tokenBuffer();
+		} else {
+			lexTokens();
+		}
+	}
+
+	//If the tokens were already needed, parse from them
+	// rather than lexing the input a second time
+	ArenaScope scope(&myArena);
+	int errCode;
+	{
+		PhaseTimer timer(Stats::PARSE, &myArena);
+		ASTNode::resetIds();
+		if (lexed){
+			Scanner scanner(&myTokens, &myTokenDiags);
+			Parser parser(scanner, &myAST);
+			errCode = parser.parse();
+		} else if (useTokenBuffer){
+			Scanner scanner(tokenBuffer(), source());
+			Parser parser(scanner, &myAST);
+			errCode = parser.parse();
+		} else {
+			Scanner scanner(source());
+			scanner.setHandWritten(handLexer);
+			Parser parser(scanner, &myAST);
+			errCode = parser.parse();
+		}
+	}
+	if (errCode != 0){ myAST = nullptr; }
+	if (stats != nullptr){ stats->classifyNodes(); }
+	return myAST;
+}
+
+NameAnalysis * Session::nameAnalysis(){
+	if (namesChecked){ return myNameAnalysis; }
+	namesChecked = true;
+
+	ProgramNode * root = ast();
+	if (root == nullptr){ return nullptr; }
+	PhaseTimer timer(Stats::NAME_ANALYSIS);
+	if (fused){
+		myNameAnalysis = NameAnalysis::buildFused(root, &myFusedTypes);
+	} else {
+		myNameAnalysis = NameAnalysis::build(root, myThreads);
+	}
+	return myNameAnalysis;
+}
+
+TypeAnalysis * Session::typeAnalysis(){
+	if (typesChecked){ return myTypeAnalysis; }
+	typesChecked = true;
+
+	NameAnalysis * names = nameAnalysis();
+	if (names == nullptr){ return nullptr; }
+	PhaseTimer timer(Stats::TYPE_ANALYSIS);
+	if (fused){
+		//The types were checked along with the names
+		if (myFusedTypes->finishFused()){
+			myTypeAnalysis = myFusedTypes;
+			myFusedTypes = nullptr;
+		}
+	} else {
+		myTypeAnalysis = TypeAnalysis::build(names, myThreads);
+	}
+	return myTypeAnalysis;
+}
+
+FlatAST * Session::flatAST(){
+	if (flattened){ return myFlatAST; }
+	flattened = true;
+
+	if (savedAST()){
+		PhaseTimer timer(Stats::PARSE);
+		myFlatAST = FlatAST::load(source());
+		return myFlatAST;
+	}
+	ProgramNode * root = ast();
+	if (root == nullptr){ return nullptr; }
+	PhaseTimer timer(Stats::PARSE);
+	myFlatAST = FlatAST::build(root);
+	return myFlatAST;
+}
+
+FlatNameAnalysis * Session::flatNameAnalysis(){
+	if (flatNamesChecked){ return myFlatNames; }
+	flatNamesChecked = true;
+
+	FlatAST * flat = flatAST();
+	if (flat == nullptr){ return nullptr; }
+	PhaseTimer timer(Stats::NAME_ANALYSIS);
+	myFlatNames = FlatNameAnalysis::build(flat);
+	return myFlatNames;
+}
+
+FlatTypeAnalysis * Session::flatTypeAnalysis(){
+	if (flatTypesChecked){ return myFlatTypes; }
+	flatTypesChecked = true;
+
+	FlatNameAnalysis * names = flatNameAnalysis();
+	if (names == nullptr){ return nullptr; }
+	PhaseTimer timer(Stats::TYPE_ANALYSIS);
+	myFlatTypes = FlatTypeAnalysis::build(names);
+	return myFlatTypes;
+}
+
+void Session::writeTokens(std::ostream& out){
+	for (Token * tok : *tokens()){
+		out << tok->toString() << std::endl;
+	}
+}
+
+}
@@ -0,0 +1,118 @@
+#ifndef CMINUSMINUS_SESSION_HPP
+#define CMINUSMINUS_SESSION_HPP
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include "arena.hpp"
+#include "diagnostics.hpp"
+#include "tokens.hpp"
+#include "token_buffer.hpp"
+#include "source_buffer.hpp"
+#include "stats.hpp"
+#include "ast.hpp"
+#include "name_analysis.hpp"
+#include "type_analysis.hpp"
+#include "flat_analysis.hpp"
+
+namespace cminusminus{
+
+//A Session holds every front-end result for a single input
+// file. Each stage (the token stream, the AST, the name
+// analysis and the type analysis) is built the first time it
+// is asked for and then shared by every later request, so the
+// input is read, lexed and parsed at most once no matter how
+// many outputs the driver wants. Lexing a large file and
+// semantic analysis may use up to threadsIn worker threads
+// within the file.
+class Session{
+public:
+	//sourceIn, if given, is the input already read from
+	// inPathIn, which the session then owns rather than mapping
+	// the file again
+	Session(const char * inPathIn, size_t threadsIn = 1,
+		SourceBuffer * sourceIn = nullptr);
+	~Session();
+
+	//The complete token stream, ending in an END token. Every
+	// lexical error is reported.
+	const std::vector<Token *> * tokens();
+	//The same stream packed into a TokenBuffer, without a
+	// Token object for each token
+	const TokenBuffer * tokenBuffer();
+	//Each of these returns nullptr if the stage (or one
+	// of the stages it depends on) failed
+	ProgramNode * ast();
+	NameAnalysis * nameAnalysis();
+	TypeAnalysis * typeAnalysis();
+
+	void writeTokens(std::ostream& out);
+	const Arena& arena() const { return myArena; }
+	//Resolve names and check types in a single traversal of
+	// the AST, rather than in two passes. The output is the same.
+	void setFused(bool fusedIn){ fused = fusedIn; }
+	//Lex with the hand-written scanner rather than the flex
+	// one. The tokens are the same.
+	void setHandLexer(bool handIn){ handLexer = handIn; }
+	//Lex the whole input into a TokenBuffer before parsing it,
+	// unless the tokens were already needed as objects. The
+	// AST is the same.
+	void setTokenBuffer(bool bufferIn){ useTokenBuffer = bufferIn; }
+
+	//The AST as a flat table (see FlatAST), and the analyses
+	// over it. Lowering the tree, or loading a saved one, is
+	// charged to the parse.
+	FlatAST * flatAST();
+	FlatNameAnalysis * flatNameAnalysis();
+	FlatTypeAnalysis * flatTypeAnalysis();
+	const char * path() const { return inPath.c_str(); }
+	//Whether the input is an AST saved by FlatAST::save rather
+	// than source. Only the flat AST and its analyses can be
+	// had from one.
+	bool savedAST(){ return FlatAST::isSaved(source()); }
+private:
+	void checkSource();
+	SourceBuffer * source();
+	//Lex into myTokens, holding the lexical errors in
+	// myTokenDiags for the parser to pass on
+	void lexTokens();
+	bool splitLexing();
+	void lexInParallel(bool toBuffer);
+
+	std::string inPath;
+	size_t myThreads;
+	//Owns the tokens, positions and AST nodes of this file,
+	// which are all freed together with the session
+	Arena myArena;
+	//The memory-mapped input. Tokens point into it, so it
+	// lives as long as the session does
+	SourceBuffer * mySource = nullptr;
+
+	bool lexed = false;
+	bool parsed = false;
+	bool namesChecked = false;
+	bool typesChecked = false;
+	bool fused = false;
+	bool handLexer = false;
+	bool useTokenBuffer = false;
+	bool buffered = false;
+	bool flattened = false;
+	bool flatNamesChecked = false;
+	bool flatTypesChecked = false;
+
+	std::vector<Token *> myTokens;
+	HeldDiagnostics myTokenDiags;
+	TokenBuffer myTokenBuffer;
+	ProgramNode * myAST = nullptr;
+	NameAnalysis * myNameAnalysis = nullptr;
+	TypeAnalysis * myTypeAnalysis = nullptr;
+	//The type analysis of a fused pass, until it is finished
+	TypeAnalysis * myFusedTypes = nullptr;
+	FlatAST * myFlatAST = nullptr;
+	FlatNameAnalysis * myFlatNames = nullptr;
+	FlatTypeAnalysis * myFlatTypes = nullptr;
+};
+
+}
+
+#endif
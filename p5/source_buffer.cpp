@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include "errors.hpp"
+#include "source_buffer.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cminusminus{
+
+//Every live buffer, in the slot given by the low bits of its id.
+// The rest of the id counts how often the slot has been reused,
+// so that the id of a destroyed buffer does not name the next
+// one in its slot. Slot 0 is left empty so that a default
+// Position refers to no file at all. Lookups only load a slot;
+// the lock is taken to hand out and give back ids.
+static const uint32_t NUM_SLOTS = 4096;
+static std::atomic<SourceBuffer *> registry[NUM_SLOTS];
+static std::mutex registryLock;
+//The next id for each slot that has been given back
+static std::vector<uint32_t> freeIds;
+static uint32_t unusedSlot = 1;
+
+SourceBuffer::SourceBuffer() : myData(""), mySize(0){
+	std::lock_guard<std::mutex> guard(registryLock);
+	if (!freeIds.empty()){
+		myId = freeIds.back();
+		freeIds.pop_back();
+	} else if (unusedSlot < NUM_SLOTS){
+		myId = unusedSlot++;
+	} else {
+		throw new InternalError("Too many source buffers at once");
+	}
+	registry[myId % NUM_SLOTS].store(this, std::memory_order_release);
+}
+
+SourceBuffer * SourceBuffer::lookup(uint32_t id){
+	SourceBuffer * buf =
+		registry[id % NUM_SLOTS].load(std::memory_order_acquire);
+	if (buf == nullptr || buf->myId != id){ return nullptr; }
+	return buf;
+}
+
+SourceBuffer * SourceBuffer::checkSize(SourceBuffer * buf){
+	if (buf != nullptr && buf->mySize > UINT32_MAX){
+		delete buf;
+		return nullptr;
+	}
+	return buf;
+}
+
+const std::vector<uint32_t>& SourceBuffer::lineStarts(){
+	std::call_once(myLinesBuilt, [this](){
+		myLineStarts.push_back(0);
+		for (size_t i = 0; i < mySize; i++){
+			if (myData[i] == '\n'){
+				myLineStarts.push_back(static_cast<uint32_t>(i + 1));
+			}
+		}
+	});
+	return myLineStarts;
+}
+
+void SourceBuffer::lineCol(size_t offset, size_t& line, size_t& col){
+	lineStarts();
+	auto next = std::upper_bound(myLineStarts.begin(),
+		myLineStarts.end(), offset);
+	size_t idx = static_cast<size_t>(next - myLineStarts.begin()) - 1;
+	line = idx + 1;
+	col = offset - myLineStarts[idx] + 1;
+}
+
+SourceBuffer * SourceBuffer::map(const char * path){
+#ifndef _WIN32
+	int fd = open(path, O_RDONLY);
+	if (fd < 0){ return nullptr; }
+	struct stat info;
+	if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)){
+		close(fd);
+		//Not something we can map (a pipe, say), so fall
+		// back to reading it
+		std::ifstream in(path, std::ios::binary);
+		if (!in.good()){ return nullptr; }
+		return checkSize(read(in));
+	}
+	SourceBuffer * buf = new SourceBuffer();
+	size_t len = static_cast<size_t>(info.st_size);
+	if (len > 0){
+		void * addr = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (addr == MAP_FAILED){
+			close(fd);
+			delete buf;
+			std::ifstream in(path, std::ios::binary);
+			if (!in.good()){ return nullptr; }
+			return checkSize(read(in));
+		}
+		madvise(addr, len, MADV_SEQUENTIAL);
+		buf->myData = static_cast<const char *>(addr);
+		buf->mySize = len;
+		buf->myMappedSize = len;
+	}
+	close(fd);
+	return checkSize(buf);
+#else
+	std::ifstream in(path, std::ios::binary);
+	if (!in.good()){ return nullptr; }
+	return checkSize(read(in));
+#endif
+}
+
+SourceBuffer * SourceBuffer::borrow(const char * dataIn, size_t sizeIn){
+	SourceBuffer * buf = new SourceBuffer();
+	buf->myData = dataIn;
+	buf->mySize = sizeIn;
+	return buf;
+}
+
+SourceBuffer * SourceBuffer::fromLines(std::vector<uint32_t> lineStartsIn){
+	SourceBuffer * buf = new SourceBuffer();
+	if (lineStartsIn.empty()){ lineStartsIn.push_back(0); }
+	buf->myLineStarts = std::move(lineStartsIn);
+	std::call_once(buf->myLinesBuilt, [](){ });
+	return buf;
+}
+
+SourceBuffer * SourceBuffer::read(std::istream& in){
+	SourceBuffer * buf = new SourceBuffer();
+	std::ostringstream contents;
+	contents << in.rdbuf();
+	buf->myCopy = contents.str();
+	buf->myData = buf->myCopy.data();
+	buf->mySize = buf->myCopy.size();
+	return buf;
+}
+
+SourceBuffer::~SourceBuffer(){
+	registry[myId % NUM_SLOTS].store(nullptr, std::memory_order_release);
+	{
+		std::lock_guard<std::mutex> guard(registryLock);
+		freeIds.push_back(myId + NUM_SLOTS);
+	}
+#ifndef _WIN32
+	if (myMappedSize > 0){
+		munmap(const_cast<char *>(myData), myMappedSize);
+	}
+#endif
+}
+
+}
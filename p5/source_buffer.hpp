@@ -0,0 +1,69 @@
+#ifndef CMINUSMINUS_SOURCE_BUFFER_HPP
+#define CMINUSMINUS_SOURCE_BUFFER_HPP
+
+#include <cstdint>
+#include <istream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace cminusminus{
+
+//The complete text of one input. The bytes come from
+// memory-mapping a file, from a buffer that the caller owns,
+// or (for plain streams) from a private copy. Tokens that
+// carry text (IDs and string literals) point into the buffer
+// rather than copying out of it, so a SourceBuffer must
+// outlive every token lexed from it.
+//
+//Each buffer is registered under an integer id, which is
+// what a Position records instead of a line and column. Lines
+// and columns are recovered through lineCol(), from an index of
+// line starts that is only built the first time it is needed.
+class SourceBuffer{
+public:
+	//Map the file at path into memory. Returns nullptr if the
+	// file cannot be opened, or is too large for a Position to
+	// address (4GB).
+	static SourceBuffer * map(const char * path);
+	//Wrap bytes owned by the caller. They must stay valid (and
+	// unchanged) for as long as the SourceBuffer is in use.
+	static SourceBuffer * borrow(const char * dataIn, size_t sizeIn);
+	//Read everything remaining in a stream into a private copy
+	static SourceBuffer * read(std::istream& in);
+	//A buffer with no text, only the line index of some source
+	// that is not at hand (see FlatAST::load). Positions in it
+	// still print as lines and columns.
+	static SourceBuffer * fromLines(std::vector<uint32_t> lineStartsIn);
+	~SourceBuffer();
+
+	const char * data() const { return myData; }
+	size_t size() const { return mySize; }
+	uint32_t id() const { return myId; }
+
+	//The 1-based line and column of a byte offset. Columns
+	// count bytes, as the scanner always has.
+	void lineCol(size_t offset, size_t& line, size_t& col);
+	//The offset of the start of each line
+	const std::vector<uint32_t>& lineStarts();
+
+	//The live buffer with the given id, or nullptr if it has
+	// been destroyed. Id 0 never names a buffer. Takes no lock,
+	// since every Position printed comes through here.
+	static SourceBuffer * lookup(uint32_t id);
+private:
+	SourceBuffer();
+	static SourceBuffer * checkSize(SourceBuffer * buf);
+	const char * myData;
+	size_t mySize;
+	uint32_t myId;
+	std::once_flag myLinesBuilt;
+	std::vector<uint32_t> myLineStarts;
+	//Nonzero only when myData is a mapping we must unmap
+	size_t myMappedSize = 0;
+	std::string myCopy;
+};
+
+}
+
+#endif
@@ -0,0 +1,246 @@
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <new>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+#include "stats.hpp"
+#include "arena.hpp"
+#include "ast.hpp"
+
+#ifdef __GNUG__
+#include <cxxabi.h>
+#endif
+
+//Every heap allocation in the compiler goes through these, so
+// that -stats can report how many each phase makes. The counts
+// are per thread and are kept whether or not anyone reads them.
+static thread_local size_t heapAllocCount = 0;
+static thread_local size_t heapByteCount = 0;
+
+static void * countedAlloc(size_t size){
+	heapAllocCount++;
+	heapByteCount += size;
+	void * mem = malloc(size == 0 ? 1 : size);
+	if (mem == nullptr){ throw std::bad_alloc(); }
+	return mem;
+}
+
+void * operator new(size_t size){ return countedAlloc(size); }
+void * operator new[](size_t size){ return countedAlloc(size); }
+void operator delete(void * mem) noexcept { free(mem); }
+void operator delete[](void * mem) noexcept { free(mem); }
+void operator delete(void * mem, size_t) noexcept { free(mem); }
+void operator delete[](void * mem, size_t) noexcept { free(mem); }
+
+namespace cminusminus{
+
+static double cpuNowMs(){
+#ifndef _WIN32
+	struct timespec now;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+	return static_cast<double>(now.tv_sec) * 1000.0
+		+ static_cast<double>(now.tv_nsec) / 1000000.0;
+#else
+	return static_cast<double>(std::clock()) * 1000.0 / CLOCKS_PER_SEC;
+#endif
+}
+
+size_t Stats::heapAllocs(){ return heapAllocCount; }
+size_t Stats::heapBytes(){ return heapByteCount; }
+
+const char * Stats::phaseName(int phase){
+	switch (phase){
+	case SCAN: return "scan";
+	case PARSE: return "parse";
+	case NAME_ANALYSIS: return "name_analysis";
+	case TYPE_ANALYSIS: return "type_analysis";
+	case UNPARSE: return "unparse";
+	}
+	return "unknown";
+}
+
+//The unqualified class name of a type
+static std::string className(const std::type_index& info){
+	std::string name = info.name();
+#ifdef __GNUG__
+	int status = 0;
+	char * demangled = abi::__cxa_demangle(info.name(), nullptr,
+		nullptr, &status);
+	if (status == 0 && demangled != nullptr){ name = demangled; }
+	free(demangled);
+#endif
+	size_t sep = name.rfind("::");
+	if (sep != std::string::npos){ name = name.substr(sep + 2); }
+	return name;
+}
+
+void Stats::classifyNodes(){
+	//Count by type first, so that each class name is only
+	// demangled once
+	std::unordered_map<std::type_index, size_t> counts;
+	for (const ASTNode * node : newNodes){
+		counts[std::type_index(typeid(*node))]++;
+	}
+	newNodes.clear();
+	for (auto& entry : counts){
+		nodesByClass[className(entry.first)] += entry.second;
+	}
+}
+
+void Stats::merge(const Stats& other){
+	files += other.files;
+	for (int i = 0; i < NUM_PHASES; i++){
+		PhaseStats& mine = phases[i];
+		const PhaseStats& theirs = other.phases[i];
+		mine.wallMs += theirs.wallMs;
+		mine.cpuMs += theirs.cpuMs;
+		mine.heapAllocs += theirs.heapAllocs;
+		mine.heapBytes += theirs.heapBytes;
+		mine.arenaAllocs += theirs.arenaAllocs;
+		mine.arenaBytes += theirs.arenaBytes;
+	}
+	tokens += other.tokens;
+	scopesEntered += other.scopesEntered;
+	symbolLookups += other.symbolLookups;
+	symbolMisses += other.symbolMisses;
+	typeInsertions += other.typeInsertions;
+	cacheHits += other.cacheHits;
+	cacheMisses += other.cacheMisses;
+	for (auto& entry : other.nodesByClass){
+		nodesByClass[entry.first] += entry.second;
+	}
+}
+
+void Stats::writeText(std::ostream& out) const{
+	char line[160];
+	out << "cmmc statistics (" << files
+		<< (files == 1 ? " file" : " files") << ")\n";
+	snprintf(line, sizeof(line), "%-15s %10s %10s %12s %12s %12s %12s\n",
+		"phase", "wall ms", "cpu ms", "heap allocs", "heap bytes",
+		"arena allocs", "arena bytes");
+	out << line;
+	PhaseStats total;
+	for (int i = 0; i < NUM_PHASES; i++){
+		const PhaseStats& p = phases[i];
+		snprintf(line, sizeof(line),
+			"%-15s %10.3f %10.3f %12zu %12zu %12zu %12zu\n",
+			phaseName(i), p.wallMs, p.cpuMs, p.heapAllocs, p.heapBytes,
+			p.arenaAllocs, p.arenaBytes);
+		out << line;
+		total.wallMs += p.wallMs;
+		total.cpuMs += p.cpuMs;
+		total.heapAllocs += p.heapAllocs;
+		total.heapBytes += p.heapBytes;
+		total.arenaAllocs += p.arenaAllocs;
+		total.arenaBytes += p.arenaBytes;
+	}
+	snprintf(line, sizeof(line),
+		"%-15s %10.3f %10.3f %12zu %12zu %12zu %12zu\n",
+		"total", total.wallMs, total.cpuMs, total.heapAllocs,
+		total.heapBytes, total.arenaAllocs, total.arenaBytes);
+	out << line;
+
+	out << "counters:\n";
+	out << "  tokens               " << tokens << "\n";
+	out << "  scopes entered       " << scopesEntered << "\n";
+	out << "  symbol lookups       " << symbolLookups << "\n";
+	out << "  symbol misses        " << symbolMisses << "\n";
+	out << "  node type insertions " << typeInsertions << "\n";
+	out << "  cache hits           " << cacheHits << "\n";
+	out << "  cache misses         " << cacheMisses << "\n";
+	out << "AST nodes by class:\n";
+	size_t nodes = 0;
+	for (auto& entry : nodesByClass){
+		snprintf(line, sizeof(line), "  %-20s %zu\n",
+			entry.first.c_str(), entry.second);
+		out << line;
+		nodes += entry.second;
+	}
+	out << "  total                " << nodes << "\n";
+}
+
+void Stats::writeJSON(std::ostream& out) const{
+	char num[64];
+	out << "{\n  \"files\": " << files << ",\n  \"phases\": {";
+	for (int i = 0; i < NUM_PHASES; i++){
+		const PhaseStats& p = phases[i];
+		out << (i == 0 ? "\n" : ",\n");
+		out << "    \"" << phaseName(i) << "\": {";
+		snprintf(num, sizeof(num), "%.3f", p.wallMs);
+		out << "\"wall_ms\": " << num;
+		snprintf(num, sizeof(num), "%.3f", p.cpuMs);
+		out << ", \"cpu_ms\": " << num;
+		out << ", \"heap_allocs\": " << p.heapAllocs
+			<< ", \"heap_bytes\": " << p.heapBytes
+			<< ", \"arena_allocs\": " << p.arenaAllocs
+			<< ", \"arena_bytes\": " << p.arenaBytes << "}";
+	}
+	out << "\n  },\n  \"counters\": {"
+		<< "\"tokens\": " << tokens
+		<< ", \"scopes_entered\": " << scopesEntered
+		<< ", \"symbol_lookups\": " << symbolLookups
+		<< ", \"symbol_misses\": " << symbolMisses
+		<< ", \"node_type_insertions\": " << typeInsertions
+		<< ", \"cache_hits\": " << cacheHits
+		<< ", \"cache_misses\": " << cacheMisses
+		<< "},\n  \"ast_nodes\": {";
+	bool first = true;
+	for (auto& entry : nodesByClass){
+		//Class names are C++ identifiers, so need no escaping
+		out << (first ? "" : ", ")
+			<< "\"" << entry.first << "\": " << entry.second;
+		first = false;
+	}
+	out << "}\n}\n";
+}
+
+PhaseTimer::PhaseTimer(Stats::Phase phaseIn, const Arena * arenaIn)
+: phase(nullptr), arena(arenaIn){
+	Stats * stats = Stats::current();
+	if (stats == nullptr){ return; }
+	phase = &stats->phases[phaseIn];
+	if (arena != nullptr){
+		arenaAllocsStart = arena->allocations();
+		arenaBytesStart = arena->bytesAllocated();
+	}
+	heapAllocsStart = Stats::heapAllocs();
+	heapBytesStart = Stats::heapBytes();
+	cpuStart = cpuNowMs();
+	wallStart = std::chrono::steady_clock::now();
+}
+
+PhaseTimer::~PhaseTimer(){
+	if (phase == nullptr){ return; }
+	auto wallEnd = std::chrono::steady_clock::now();
+	double cpuEnd = cpuNowMs();
+	phase->wallMs += std::chrono::duration<double, std::milli>(
+		wallEnd - wallStart).count();
+	phase->cpuMs += cpuEnd - cpuStart;
+	phase->heapAllocs += Stats::heapAllocs() - heapAllocsStart;
+	phase->heapBytes += Stats::heapBytes() - heapBytesStart;
+	if (arena != nullptr){
+		phase->arenaAllocs += arena->allocations() - arenaAllocsStart;
+		phase->arenaBytes += arena->bytesAllocated() - arenaBytesStart;
+	}
+}
+
+
+WorkerTimer::WorkerTimer(Stats::Phase phaseIn) : phase(nullptr){
+	Stats * stats = Stats::current();
+	if (stats == nullptr){ return; }
+	phase = &stats->phases[phaseIn];
+	heapAllocsStart = Stats::heapAllocs();
+	heapBytesStart = Stats::heapBytes();
+	cpuStart = cpuNowMs();
+}
+
+WorkerTimer::~WorkerTimer(){
+	if (phase == nullptr){ return; }
+	phase->cpuMs += cpuNowMs() - cpuStart;
+	phase->heapAllocs += Stats::heapAllocs() - heapAllocsStart;
+	phase->heapBytes += Stats::heapBytes() - heapBytesStart;
+}
+
+}
@@ -0,0 +1,122 @@
+#ifndef CMINUSMINUS_STATS_HPP
+#define CMINUSMINUS_STATS_HPP
+
+#include <chrono>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace cminusminus{
+
+class ASTNode;
+class Arena;
+
+//Timings and counters for one or more compilations, collected
+// when cmmc is run with -stats. The front end bumps the
+// counters of the thread's current Stats (see StatsScope); when
+// there is none, collecting costs a single null check.
+class Stats{
+public:
+	enum Phase{ SCAN, PARSE, NAME_ANALYSIS, TYPE_ANALYSIS, UNPARSE,
+		NUM_PHASES };
+
+	struct PhaseStats{
+		double wallMs = 0;
+		double cpuMs = 0;
+		size_t heapAllocs = 0;
+		size_t heapBytes = 0;
+		size_t arenaAllocs = 0;
+		size_t arenaBytes = 0;
+	};
+
+	size_t files = 0;
+	PhaseStats phases[NUM_PHASES];
+	size_t tokens = 0;
+	size_t scopesEntered = 0;
+	size_t symbolLookups = 0;
+	size_t symbolMisses = 0;
+	size_t typeInsertions = 0;
+	//Lookups in the compile cache (see CompileCache)
+	size_t cacheHits = 0;
+	size_t cacheMisses = 0;
+	std::map<std::string, size_t> nodesByClass;
+
+	//The collector for the calling thread, or nullptr
+	static Stats * current(){ return currentRef(); }
+
+	//Nodes are recorded as they are built and sorted by class
+	// once the tree is complete, when their dynamic types are
+	// known
+	void noteNode(const ASTNode * node){ newNodes.push_back(node); }
+	void classifyNodes();
+
+	//Fold another file's statistics into these
+	void merge(const Stats& other);
+
+	void writeText(std::ostream& out) const;
+	void writeJSON(std::ostream& out) const;
+
+	static const char * phaseName(int phase);
+	//The calling thread's running heap allocation totals
+	static size_t heapAllocs();
+	static size_t heapBytes();
+private:
+	friend class StatsScope;
+	static Stats *& currentRef(){
+		thread_local Stats * active = nullptr;
+		return active;
+	}
+	std::vector<const ASTNode *> newNodes;
+};
+
+//Makes a Stats the current one for as long as the scope lives
+class StatsScope{
+public:
+	StatsScope(Stats * stats) : saved(Stats::currentRef()){
+		Stats::currentRef() = stats;
+	}
+	~StatsScope(){ Stats::currentRef() = saved; }
+private:
+	Stats * saved;
+};
+
+//Charges the time and allocations between its construction and
+// destruction to one phase of the current Stats. Does nothing
+// when statistics are not being collected. The CPU time and
+// heap counts are the calling thread's own; work handed to
+// other threads is charged by a WorkerTimer on each of them.
+class PhaseTimer{
+public:
+	PhaseTimer(Stats::Phase phaseIn, const Arena * arenaIn = nullptr);
+	~PhaseTimer();
+private:
+	Stats::PhaseStats * phase;
+	const Arena * arena;
+	std::chrono::steady_clock::time_point wallStart;
+	double cpuStart = 0;
+	size_t heapAllocsStart = 0;
+	size_t heapBytesStart = 0;
+	size_t arenaAllocsStart = 0;
+	size_t arenaBytesStart = 0;
+};
+
+//Charges the CPU time and heap allocations of a job run on a
+// worker thread to one phase of the worker's current Stats,
+// which the submitting thread merges into its own once the job
+// is done. The wall time is left out: the submitting thread's
+// PhaseTimer already covers it.
+class WorkerTimer{
+public:
+	WorkerTimer(Stats::Phase phaseIn);
+	~WorkerTimer();
+private:
+	Stats::PhaseStats * phase;
+	double cpuStart = 0;
+	size_t heapAllocsStart = 0;
+	size_t heapBytesStart = 0;
+};
+
+}
+
+#endif
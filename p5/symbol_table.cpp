@@ -1,67 +1,186 @@
+#include <algorithm>
 #include "symbol_table.hpp"
 #include "types.hpp"
+#include "stats.hpp"
 namespace cminusminus{
 
-SymbolTable::SymbolTable(){
-	scopeTableChain = new std::list<ScopeTable *>();
+//The hash table starts with room for this many names, and
+// doubles whenever it becomes half full
+static const size_t FIRST_SLOTS = 256;
+
+const int32_t SymbolTable::NONE;
+
+SymbolTable::SymbolTable() : slots(FIRST_SLOTS, Slot{nullptr, NONE}){
+	scopes.reserve(16);
+	bindings.reserve(64);
+}
+
+SymbolTable::SymbolTable(const GlobalScope * globalsIn) : SymbolTable(){
+	myGlobals = globalsIn;
+}
+
+//Interned names are unique pointers, so hashing the address
+// is enough. The low bits are always zero, so mix them away.
+static size_t hashIdent(Ident name){
+	uint64_t bits = reinterpret_cast<uintptr_t>(name);
+	bits *= 0x9E3779B97F4A7C15ULL;
+	return static_cast<size_t>(bits >> 32);
+}
+
+SymbolTable::Slot& SymbolTable::slotFor(Ident name){
+	size_t mask = slots.size() - 1;
+	size_t idx = hashIdent(name) & mask;
+	while (slots[idx].name != nullptr && slots[idx].name != name){
+		idx = (idx + 1) & mask;
+	}
+	return slots[idx];
+}
+
+void SymbolTable::grow(){
+	std::vector<Slot> old(slots.size() * 2, Slot{nullptr, NONE});
+	old.swap(slots);
+	for (const Slot& slot : old){
+		if (slot.name != nullptr){ slotFor(slot.name) = slot; }
+	}
 }
 
 void SymbolTable::print(){
-	for(auto scope : *scopeTableChain){
+	for (size_t level = scopes.size(); level > 0; level--){
 		std::cout << "--- scope ---\n";
-		std::cout << scope->toString();
+		std::cout << scopeString(static_cast<uint32_t>(level - 1));
 	}
 }
 
-ScopeTable * SymbolTable::enterScope(){
-	ScopeTable * newScope = new ScopeTable();
-	scopeTableChain->push_front(newScope);
-	return newScope;
+ScopeTable SymbolTable::enterScope(){
+	if (Stats * stats = Stats::current()){ stats->scopesEntered++; }
+	scopes.push_back(NONE);
+	return getCurrentScope();
 }
 
 void SymbolTable::leaveScope(){
-	if (scopeTableChain->empty()){
+	if (scopes.empty()){
 		throw new InternalError("Attempt to pop"
 			"empty symbol table");
 	}
-	scopeTableChain->pop_front();
+	//This scope's bindings are the innermost of their names,
+	// so each is at the front of its chain
+	int32_t idx = scopes.back();
+	while (idx != NONE){
+		Binding& binding = bindings[static_cast<size_t>(idx)];
+		slotFor(binding.symbol->getIdent()).head = binding.shadowed;
+		int32_t prev = binding.prevInScope;
+		binding.shadowed = freeBindings;
+		freeBindings = idx;
+		idx = prev;
+	}
+	scopes.pop_back();
 }
 
-ScopeTable * SymbolTable::getCurrentScope(){
-	return scopeTableChain->front();
+ScopeTable SymbolTable::getCurrentScope(){
+	return ScopeTable(this, static_cast<uint32_t>(scopes.size() - 1));
 }
 
-bool SymbolTable::clash(std::string varName){
-	bool hasClash = getCurrentScope()->clash(varName);
+bool SymbolTable::clash(Ident varName){
+	bool hasClash = getCurrentScope().clash(varName);
 	return hasClash;
 }
 
-SemSymbol * SymbolTable::find(std::string varName){
-	for (ScopeTable * scope : *scopeTableChain){
-		SemSymbol * sym = scope->lookup(varName);
-		if (sym != nullptr) { return sym; }
+SemSymbol * SymbolTable::find(Ident varName){
+	Stats * stats = Stats::current();
+	if (stats != nullptr){ stats->symbolLookups++; }
+	int32_t head = slotFor(varName).head;
+	if (head == NONE){
+		SemSymbol * global = nullptr;
+		if (myGlobals != nullptr){
+			global = myGlobals->lookup(varName, myVisibleTo);
+		}
+		if (global == nullptr && stats != nullptr){ stats->symbolMisses++; }
+		return global;
 	}
-	return nullptr;
+	return bindings[static_cast<size_t>(head)].symbol;
+}
+
+std::vector<SemSymbol *> SymbolTable::currentScopeSymbols(){
+	std::vector<SemSymbol *> result;
+	for (int32_t idx = scopes.back(); idx != NONE;
+		idx = bindings[static_cast<size_t>(idx)].prevInScope){
+		result.push_back(bindings[static_cast<size_t>(idx)].symbol);
+	}
+	std::reverse(result.begin(), result.end());
+	return result;
 }
 
 bool SymbolTable::insert(SemSymbol * symbol){
-	return scopeTableChain->front()->insert(symbol);
+	return getCurrentScope().insert(symbol);
+}
+
+SemSymbol * SymbolTable::lookupAt(Ident name, uint32_t level){
+	int32_t idx = slotFor(name).head;
+	while (idx != NONE){
+		const Binding& binding = bindings[static_cast<size_t>(idx)];
+		if (binding.level == level){ return binding.symbol; }
+		if (binding.level < level){ break; }
+		idx = binding.shadowed;
+	}
+	return nullptr;
 }
 
-ScopeTable::ScopeTable(){
-	symbols = new HashMap<std::string, SemSymbol *>();
+bool SymbolTable::insertAt(SemSymbol * symbol, uint32_t level){
+	Ident name = symbol->getIdent();
+	if ((slotsUsed + 1) * 2 > slots.size()){ grow(); }
+	Slot& slot = slotFor(name);
+	if (slot.name == nullptr){
+		slot.name = name;
+		slotsUsed++;
+	}
+
+	//Find where the binding goes in the chain. Usually that is
+	// the front, but a function's own name is declared in the
+	// enclosing scope after its formals are in.
+	int32_t prev = NONE;
+	int32_t next = slot.head;
+	while (next != NONE){
+		const Binding& binding = bindings[static_cast<size_t>(next)];
+		if (binding.level == level){ return false; }
+		if (binding.level < level){ break; }
+		prev = next;
+		next = binding.shadowed;
+	}
+
+	int32_t idx;
+	Binding fresh = { symbol, level, next, scopes[level] };
+	if (freeBindings != NONE){
+		idx = freeBindings;
+		freeBindings = bindings[static_cast<size_t>(idx)].shadowed;
+		bindings[static_cast<size_t>(idx)] = fresh;
+	} else {
+		idx = static_cast<int32_t>(bindings.size());
+		bindings.push_back(fresh);
+	}
+	if (prev == NONE){
+		slot.head = idx;
+	} else {
+		bindings[static_cast<size_t>(prev)].shadowed = idx;
+	}
+	scopes[level] = idx;
+	return true;
 }
 
-std::string ScopeTable::toString(){
+std::string SymbolTable::scopeString(uint32_t level){
 	std::string result = "";
-	for (auto entry : *symbols){
-		result += entry.second->toString();
+	for (int32_t idx = scopes[level]; idx != NONE;
+		idx = bindings[static_cast<size_t>(idx)].prevInScope){
+		result += bindings[static_cast<size_t>(idx)].symbol->toString();
 		result += "\n";
 	}
 	return result;
 }
 
-bool ScopeTable::clash(std::string varName){
+std::string ScopeTable::toString(){
+	return table->scopeString(level);
+}
+
+bool ScopeTable::clash(Ident varName){
 	SemSymbol * found = lookup(varName);
 	if (found != nullptr){
 		return true;
@@ -69,22 +188,12 @@ bool ScopeTable::clash(std::string varName){
 	return false;
 }
 
-SemSymbol * ScopeTable::lookup(std::string name){
-	auto found = symbols->find(name);
-	if (found == symbols->end()){
-		return NULL;
-	}
-	return found->second;
+SemSymbol * ScopeTable::lookup(Ident name){
+	return table->lookupAt(name, level);
 }
 
 bool ScopeTable::insert(SemSymbol * symbol){
-	std::string symName = symbol->getName();
-	bool alreadyInScope = (this->lookup(symName) != NULL);
-	if (alreadyInScope){
-		return false;
-	}
-	this->symbols->insert(std::make_pair(symName, symbol));
-	return true;
+	return table->insertAt(symbol, level);
 }
 
 std::string SemSymbol::toString(){
@@ -3,7 +3,10 @@
 #include <string>
 #include <unordered_map>
 #include <list>
+#include <vector>
+#include <cstdint>
 #include "types.hpp"
+#include "interner.hpp"
 
 //Use an alias template so that we can use
 // "HashMap" and it means "std::unordered_map"
@@ -26,10 +29,11 @@ enum SymbolKind {
 // symbol table. 
 class SemSymbol {
 public:
-	SemSymbol(std::string nameIn, const DataType * typeIn) 
+	SemSymbol(Ident nameIn, const DataType * typeIn) 
 	: myName(nameIn), myType(typeIn){ }
 	virtual std::string toString();
-	std::string getName() const { return myName; }
+	const std::string& getName() const { return *myName; }
+	Ident getIdent() const { return myName; }
 	virtual SymbolKind getKind() const = 0;
 
 	virtual const DataType * getDataType() const{
@@ -44,66 +48,149 @@ public:
 		return "UNKNOWN KIND";
 	} 
 private:
-	std::string myName;
+	Ident myName;
 	const DataType * myType;
 };
 
 class VarSymbol : public SemSymbol {
 public:
-	VarSymbol(std::string name, const DataType * type) 
+	VarSymbol(Ident name, const DataType * type) 
 	: SemSymbol(name, type) { }
 	virtual SymbolKind getKind() const override { return VAR; } 
 };
 
 class FnSymbol : public SemSymbol{
 public:
-	FnSymbol(std::string name, const FnType * fnType)
+	FnSymbol(Ident name, const FnType * fnType)
 	: SemSymbol(name, fnType){ }
 	virtual SymbolKind getKind() const { return FN; }
 	SymbolKind getKind(){ return FN; } 
 };
 
-//A single scope. The symbol table is broken down into a 
-// chain of scope tables, and each scope table holds 
-// semantic symbols for a single scope. For example,
-// the globals scope will be represented by a ScopeTable,
-// and the contents of each function can be represented by
-// a ScopeTable.
+class SymbolTable;
+
+//The global scope of a program, frozen once every global has
+// been declared so that function bodies can be resolved
+// against it concurrently. Each symbol remembers the index of
+// the global that declared it: as in a single pass over the
+// program, a body only sees the globals up to its own function.
+class GlobalScope{
+	public:
+		void add(SemSymbol * symbol, size_t declIndex){
+			symbols[symbol->getIdent()] = Entry{symbol, declIndex};
+		}
+		SemSymbol * lookup(Ident name, size_t visibleTo) const{
+			auto found = symbols.find(name);
+			if (found == symbols.end()){ return nullptr; }
+			if (found->second.declIndex > visibleTo){ return nullptr; }
+			return found->second.symbol;
+		}
+		bool contains(Ident name) const{
+			return symbols.find(name) != symbols.end();
+		}
+	private:
+		struct Entry{
+			SemSymbol * symbol;
+			size_t declIndex;
+		};
+		HashMap<Ident, Entry> symbols;
+};
+
+//A handle on one scope of a SymbolTable: the globals, the body
+// of a function, or the body of an if or while. Handles are
+// small values that stay valid for as long as their scope is
+// open; the symbols themselves live in the SymbolTable.
 class ScopeTable {
 	public:
-		ScopeTable();
-		SemSymbol * lookup(std::string name);
+		ScopeTable(SymbolTable * tableIn, uint32_t levelIn)
+		: table(tableIn), level(levelIn){ }
+		SemSymbol * lookup(Ident name);
 		bool insert(SemSymbol * symbol);
-		bool clash(std::string name);
+		bool clash(Ident name);
 		std::string toString();
-		void addVar(std::string name, const DataType * type){
+		void addVar(Ident name, const DataType * type){
 			insert(new VarSymbol(name, type));
 		}
-		void addFn(std::string name, FnType * type){
+		void addFn(Ident name, const FnType * type){
 			insert(new FnSymbol(name, type));
 		}
 	private:
-		HashMap<std::string, SemSymbol *> * symbols;
+		SymbolTable * table;
+		uint32_t level;
 };
 
+//The symbol table, organized as in LeBlanc and Cook's design:
+// one open-addressing hash table, keyed on interned
+// identifiers, maps each name to the innermost declaration
+// visible for it. Each declaration (a binding) links to the
+// one it shadows, so the bindings of a name form a chain that
+// runs from the innermost scope outwards. Each binding is also
+// on a list of the bindings of its scope.
+//
+//Entering a scope pushes an empty record on a contiguous stack,
+// and leaving one pops the scope's bindings off the front of
+// their chains. Neither allocates. Finding a name is a
+// single probe of the hash table.
 class SymbolTable{
 	public:
 		SymbolTable();
-		ScopeTable * enterScope();
+		//A table for the inside of functions, in which names
+		// not declared locally are looked up in a frozen global
+		// scope (see showGlobalsTo)
+		SymbolTable(const GlobalScope * globalsIn);
+		ScopeTable enterScope();
 		void leaveScope();
-		ScopeTable * getCurrentScope();
+		ScopeTable getCurrentScope();
 		bool insert(SemSymbol * symbol);
-		SemSymbol * find(std::string varName);
-		bool clash(std::string name);
-		void addVar(std::string name, const DataType * type){
-			getCurrentScope()->addVar(name, type);
+		SemSymbol * find(Ident varName);
+		bool clash(Ident name);
+		void addVar(Ident name, const DataType * type){
+			getCurrentScope().addVar(name, type);
 		}
-		void addFn(std::string name, FnType * type){
-			getCurrentScope()->addFn(name, type);
+		void addFn(Ident name, const FnType * type){
+			getCurrentScope().addFn(name, type);
 		}
 		void print();
+		//Only the globals declared up to index visibleTo are
+		// found in the frozen global scope
+		void showGlobalsTo(size_t visibleTo){ myVisibleTo = visibleTo; }
+		//The symbols of the innermost scope, in the order they
+		// were declared
+		std::vector<SemSymbol *> currentScopeSymbols();
 	private:
-		std::list<ScopeTable *> * scopeTableChain;
+		friend class ScopeTable;
+		static const int32_t NONE = -1;
+
+		struct Binding{
+			SemSymbol * symbol;
+			uint32_t level;
+			//The binding of the same name that this one hides
+			// (on the free list, the next free binding)
+			int32_t shadowed;
+			//The binding declared before this one in its scope
+			int32_t prevInScope;
+		};
+		struct Slot{
+			Ident name;
+			//The innermost binding of name, or NONE
+			int32_t head;
+		};
+
+		//The binding of name declared exactly at level, if any
+		SemSymbol * lookupAt(Ident name, uint32_t level);
+		bool insertAt(SemSymbol * symbol, uint32_t level);
+		std::string scopeString(uint32_t level);
+		Slot& slotFor(Ident name);
+		void grow();
+
+		std::vector<Slot> slots;
+		size_t slotsUsed = 0;
+		std::vector<Binding> bindings;
+		int32_t freeBindings = NONE;
+		//For each open scope, the last binding declared in it
+		std::vector<int32_t> scopes;
+		const GlobalScope * myGlobals = nullptr;
+		size_t myVisibleTo = 0;
 };
 
 	
@@ -0,0 +1,45 @@
+#include "token_buffer.hpp"
+#include "grammar.hh"
+
+namespace cminusminus{
+
+using TokenKind = cminusminus::Parser::token;
+
+void TokenBuffer::addID(size_t start, size_t end, Ident spelling){
+	add(TokenKind::ID, start, end, static_cast<int32_t>(idents.size()));
+	idents.push_back(spelling);
+}
+
+void TokenBuffer::append(const TokenBuffer& other, size_t dropLast){
+	size_t count = other.tokens.size() - dropLast;
+	//What was held for a dropped END goes with the next token
+	held.append(other.held, tokens.size());
+	//Spellings are numbered from the end of this side table
+	int32_t shift = static_cast<int32_t>(idents.size());
+	for (size_t i = 0; i < count; i++){
+		Packed tok = other.tokens[i];
+		if (tok.kind == TokenKind::ID){ tok.payload += shift; }
+		tokens.push_back(tok);
+	}
+	idents.insert(idents.end(), other.idents.begin(), other.idents.end());
+}
+
+Token * TokenBuffer::token(size_t index, const SourceBuffer * source) const{
+	const Packed& tok = tokens[index];
+	Position pos(source->id(), tok.start, tok.end);
+	switch (tok.kind){
+	case TokenKind::ID:
+		return new IDToken(pos, idents[static_cast<size_t>(tok.payload)]);
+	case TokenKind::INTLITERAL:
+		return new IntLitToken(pos, tok.payload);
+	case TokenKind::SHORTLITERAL:
+		return new ShortLitToken(pos, tok.payload);
+	case TokenKind::STRLITERAL:
+		return new StrToken(pos, source->data() + tok.start,
+			tok.end - tok.start);
+	default:
+		return new Token(pos, tok.kind);
+	}
+}
+
+}
@@ -0,0 +1,65 @@
+#ifndef CMINUSMINUS_TOKEN_BUFFER_HPP
+#define CMINUSMINUS_TOKEN_BUFFER_HPP
+
+#include <cstdint>
+#include <vector>
+#include "diagnostics.hpp"
+#include "interner.hpp"
+#include "source_buffer.hpp"
+#include "tokens.hpp"
+
+namespace cminusminus{
+
+//A whole token stream packed into one array, so that a file can
+// be lexed completely before it is parsed without making a Token
+// object for every token. Each entry holds the token's kind, its
+// span of the source and one word of payload: the index of an
+// ID's spelling in a side table, or the value of an int or short
+// literal. A string literal's text is its span of the source.
+//
+//The parser gets a Token only as it takes each one (see token),
+// so the token objects it keeps are the only ones made. What
+// the scanner reported is held with the token it came before
+// (see HeldDiagnostics).
+class TokenBuffer{
+public:
+	struct Packed{
+		int32_t kind;
+		uint32_t start;
+		uint32_t end;
+		int32_t payload;
+	};
+
+	void add(int kind, size_t start, size_t end, int32_t payload = 0){
+		tokens.push_back(Packed{kind, static_cast<uint32_t>(start),
+			static_cast<uint32_t>(end), payload});
+	}
+	void addID(size_t start, size_t end, Ident spelling);
+	//What the scanner reported before each token
+	HeldDiagnostics& diagnostics(){ return held; }
+	const HeldDiagnostics& diagnostics() const { return held; }
+	//Add other's tokens after these, leaving out the last
+	// dropLast of them (such as an END that does not end the
+	// input)
+	void append(const TokenBuffer& other, size_t dropLast = 0);
+
+	size_t size() const { return tokens.size(); }
+	const Packed& operator[](size_t index) const { return tokens[index]; }
+	//The memory held by the packed tokens and their side table
+	size_t bytes() const {
+		return tokens.capacity() * sizeof(Packed)
+			+ idents.capacity() * sizeof(Ident);
+	}
+
+	//Make the Token for the entry at index, lexed from source,
+	// in the current arena
+	Token * token(size_t index, const SourceBuffer * source) const;
+private:
+	std::vector<Packed> tokens;
+	std::vector<Ident> idents;
+	HeldDiagnostics held;
+};
+
+}
+
+#endif
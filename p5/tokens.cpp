@@ -57,70 +57,70 @@ static std::string tokenKindString(int tokKind){
 	
 }
 
-Token::Token(Position * posIn, int kindIn)
+Token::Token(const Position& posIn, int kindIn)
   : myPos(posIn), myKind(kindIn){
 }
 
 std::string Token::toString(){
 	return tokenKindString(kind())
-	+ " " + myPos->begin();
+	+ " " + myPos.begin();
 }
 
 int Token::kind() const { 
 	return this->myKind; 
 }
 
-Position * Token::pos() const {
-	return myPos;
+Position * Token::pos() {
+	return &myPos;
 }
 
-IDToken::IDToken(Position * posIn, std::string vIn)
-  : Token(posIn, TokenKind::ID), myValue(vIn){ 
+IDToken::IDToken(const Position& posIn, Ident valIn)
+  : Token(posIn, TokenKind::ID), myValue(valIn){ 
 }
 
 std::string IDToken::toString(){
 	return tokenKindString(kind()) + ":"
-	+ myValue + " " + myPos->begin();
+	+ *myValue + " " + myPos.begin();
 }
 
-const std::string IDToken::value() const { 
+Ident IDToken::value() const { 
 	return this->myValue; 
 }
 
-StrToken::StrToken(Position * posIn, std::string sIn)
-  : Token(posIn, TokenKind::STRLITERAL), myStr(sIn){
+StrToken::StrToken(const Position& posIn, const char * textIn, size_t lenIn)
+  : Token(posIn, TokenKind::STRLITERAL), myText(textIn), myLen(lenIn){
 }
 
 std::string StrToken::toString(){
 	return tokenKindString(kind()) + ":"
-	+ this->myStr + " " + myPos->begin();
+	+ str() + " " + myPos.begin();
 }
 
 const std::string StrToken::str() const {
-	return this->myStr;
+	return std::string(myText, myLen);
 }
 
-IntLitToken::IntLitToken(Position * pos, int numIn)
+IntLitToken::IntLitToken(const Position& pos, int numIn)
   : Token(pos, TokenKind::INTLITERAL), myNum(numIn){}
 
 
 std::string IntLitToken::toString(){
 	return tokenKindString(kind()) + ":"
 	+ std::to_string(this->myNum) + " "
-	+ myPos->begin();
+	+ myPos.begin();
 }
 
 int IntLitToken::num() const {
 	return this->myNum;
 }
 
-ShortLitToken::ShortLitToken(Position * pos, int numIn)
+ShortLitToken::ShortLitToken(const Position& pos, int numIn)
   : Token(pos, TokenKind::SHORTLITERAL), myNum(numIn){}
 
 std::string ShortLitToken::toString(){
 	return tokenKindString(kind()) + ":"
 	+ std::to_string(this->myNum) + " "
-	+ myPos->begin();
+	+ myPos.begin();
 }
 
 int ShortLitToken::num() const {
@@ -2,46 +2,56 @@
 #define CSHANTY_TOKEN_H
 
 #include <string>
+#include "arena.hpp"
 #include "position.hpp"
+#include "interner.hpp"
 
 namespace cminusminus{
 
-class Token{
+class Token : public ArenaObject{
 public:
-	Token(Position * pos, int kindIn);
+	Token(const Position& pos, int kindIn);
 	virtual std::string toString();
 	size_t line() const;
 	size_t col() const;
 	int kind() const;
-	Position * pos() const;
+	Position * pos();
 protected:
-	Position * myPos;
+	//Held by value: a position is only a file id and two
+	// offsets, so it is cheaper to embed than to point to
+	Position myPos;
 private:
 	const int myKind;
 };
 
+//IDs carry their interned spelling. String literals do not
+// copy their text: it stays in the scanner's source buffer,
+// which must outlive the token
 class IDToken : public Token{
 public:
-	IDToken(Position * posIn, std::string valIn);
-	const std::string value() const;
+	IDToken(const Position& posIn, Ident valIn);
+	Ident value() const;
 	virtual std::string toString() override;
 private:
-	const std::string myValue;
+	const Ident myValue;
 	
 };
 
 class StrToken : public Token{
 public:
-	StrToken(Position * posIn, std::string valIn);
+	StrToken(const Position& posIn, const char * textIn, size_t lenIn);
 	virtual std::string toString() override;
 	const std::string str() const;
+	const char * text() const { return myText; }
+	size_t length() const { return myLen; }
 private:
-	const std::string myStr;
+	const char * myText;
+	const size_t myLen;
 };
 
 class IntLitToken : public Token{
 public:
-	IntLitToken(Position * posIn, int numIn);
+	IntLitToken(const Position& posIn, int numIn);
 	virtual std::string toString() override;
 	int num() const;
 private:
@@ -50,7 +60,7 @@ private:
 
 class ShortLitToken : public Token{
 public:
-	ShortLitToken(Position * posIn, int numIn);
+	ShortLitToken(const Position& posIn, int numIn);
 	virtual std::string toString() override;
 	int num() const;
 private:
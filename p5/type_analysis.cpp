@@ -1,21 +1,29 @@
+#include <algorithm>
+#include <exception>
 #include "ast.hpp"
 #include "symbol_table.hpp"
 #include "errors.hpp"
 #include "types.hpp"
 #include "name_analysis.hpp"
 #include "type_analysis.hpp"
+#include "worker_pool.hpp"
 
 namespace cminusminus{
 
-TypeAnalysis * TypeAnalysis::build(NameAnalysis * nameAnalysis){
+TypeAnalysis * TypeAnalysis::build(NameAnalysis * nameAnalysis,
+	size_t workers){
 	//To emphasize that type analysis depends on name analysis
 	// being complete, a name analysis must be supplied for
 	// type analysis to be performed.
-	TypeAnalysis * typeAnalysis = new TypeAnalysis();
 	auto ast = nameAnalysis->ast;
+	TypeAnalysis * typeAnalysis = new TypeAnalysis(ast->nodeCount());
 	typeAnalysis->ast = ast;
 
-	ast->typeAnalysis(typeAnalysis);
+	if (workers > 1){
+		typeAnalysis->checkInParallel(workers);
+	} else {
+		ast->typeAnalysis(typeAnalysis);
+	}
 	if (typeAnalysis->hasError){
 		return nullptr;
 	}
@@ -24,6 +32,72 @@ TypeAnalysis * TypeAnalysis::build(NameAnalysis * nameAnalysis){
 
 }
 
+TypeAnalysis * TypeAnalysis::startFused(ProgramNode * astIn){
+	TypeAnalysis * typeAnalysis = new TypeAnalysis(astIn->nodeCount());
+	typeAnalysis->ast = astIn;
+	return typeAnalysis;
+}
+
+bool TypeAnalysis::finishFused(){
+	Diagnostics::current().append(fusedDiags);
+	if (fusedFailure){ std::rethrow_exception(fusedFailure); }
+	return !hasError;
+}
+
+//The results of checking one run of globals
+struct TypeRun{
+	Diagnostics diags;
+	Stats stats;
+	bool hasError = false;
+	std::exception_ptr failure;
+};
+
+void TypeAnalysis::checkInParallel(size_t workers){
+	//Once names are resolved, each global can be checked
+	// without looking at any other
+	const NodeList<DeclNode *> * globals = ast->getGlobals();
+	std::vector<DeclNode *> decls(globals->begin(), globals->end());
+	//A few runs per worker, so that one long function does not
+	// leave the others idle
+	size_t numRuns = std::min(decls.size(), workers * 4);
+	std::vector<TypeRun> runs(numRuns);
+	Stats * stats = Stats::current();
+	{
+		WorkerPool pool(std::min(workers, numRuns));
+		for (size_t r = 0; r < numRuns; r++){
+			pool.submit([&, r]{
+				TypeRun& run = runs[r];
+				StatsScope statsScope(stats == nullptr ? nullptr : &run.stats);
+				WorkerTimer timer(Stats::TYPE_ANALYSIS);
+				DiagnosticsScope diagsScope(&run.diags);
+				TypeAnalysis local(this);
+				size_t begin = decls.size() * r / numRuns;
+				size_t end = decls.size() * (r + 1) / numRuns;
+				try {
+					for (size_t i = begin; i < end; i++){
+						decls[i]->typeAnalysis(&local);
+					}
+				} catch (...) {
+					run.failure = std::current_exception();
+				}
+				run.hasError = local.hasError;
+			});
+		}
+		pool.wait();
+	}
+
+	//Put the results back together in program order, stopping
+	// where the sequential pass would have stopped
+	Diagnostics& diags = Diagnostics::current();
+	for (TypeRun& run : runs){
+		diags.append(run.diags);
+		if (stats != nullptr){ stats->merge(run.stats); }
+		if (run.failure){ std::rethrow_exception(run.failure); }
+		hasError = hasError || run.hasError;
+	}
+	nodeType(ast, BasicType::produce(VOID));
+}
+
 void ProgramNode::typeAnalysis(TypeAnalysis * ta){
 
 	//pass the TypeAnalysis down throughout
@@ -42,21 +116,25 @@ void ProgramNode::typeAnalysis(TypeAnalysis * ta){
 }
 
 void FnDeclNode::typeAnalysis(TypeAnalysis * ta){
+    typeAnalysisHeader(ta);
+    for (auto stmt : *myBody)
+    {
+        stmt->typeAnalysis(ta);
+    }
+}
 
-	ta->nodeType(this, ta->getCurrentFnType());
-    std::list<const DataType *> * formals = new std::list<const DataType *>();
+void FnDeclNode::typeAnalysisHeader(TypeAnalysis * ta){
+    FnType::Formals formals;
+    formals.reserve(this->myFormals->size());
     for(auto formal : *(this->myFormals))
     {
         auto fType = formal->getTypeNode()->getType();
-        formals->push_back(fType);
+        formals.push_back(fType);
     }
     auto ret = this->getRetTypeNode()->getType();
-    FnType * functionType = new FnType(formals, ret);
+    const FnType * functionType = FnType::produce(ret, formals);
+    ta->nodeType(this, functionType);
     ta->setCurrentFnType(functionType);
-    for (auto stmt : *myBody)
-    {
-        stmt->typeAnalysis(ta);
-    }
 }
 
 void StmtNode::typeAnalysis(TypeAnalysis * ta){
@@ -173,16 +251,16 @@ void CallExpNode::typeAnalysis(TypeAnalysis * ta) {
 
 	if(fType != nullptr)
 	{
-		if(myArgs->size() != fType->getFormalTypes()->size())
+		if(myArgs->size() != fType->getFormalTypes().size())
 		{
 			ta->errArgCount(myID->pos());
 			ta->nodeType(this, ErrorType::produce());
 		}
 		else
 		{
-			std::list<ExpNode*>::iterator acItr = myArgs->begin();
-			std::list<ExpNode*>::iterator actualsBegin = myArgs->begin();
-			auto formalTypesBegin = fType->getFormalTypes()->begin();
+			NodeList<ExpNode *>::iterator acItr = myArgs->begin();
+			NodeList<ExpNode *>::iterator actualsBegin = myArgs->begin();
+			auto formalTypesBegin = fType->getFormalTypes().begin();
 			while(acItr != myArgs->end()){
 
 				const DataType * actualType = ta->nodeType(*acItr);
@@ -1,6 +1,8 @@
 #ifndef CMINUSMINUS_TYPE_ANALYSIS
 #define CMINUSMINUS_TYPE_ANALYSIS
 
+#include <exception>
+#include <vector>
 #include "ast.hpp"
 #include "symbol_table.hpp"
 #include "types.hpp"
@@ -12,21 +14,65 @@ namespace cminusminus{
 
 // An instance of this class will be passed over the entire
 // AST. Rather than attaching types to each node, the 
-// TypeAnalysis class contains a map from each ASTNode to it's
-// DataType. Thus, instead of attaching a type field to most nodes,
-// one can instead map the node to it's type, or lookup the node
-// in the map.
+// TypeAnalysis class contains a table from each ASTNode to it's
+// DataType, indexed by the node's id. Thus, instead of attaching
+// a type field to most nodes, one can instead map the node to
+// it's type, or lookup the node in the table.
+//
+// Building with CMM_INLINE_EXP_TYPES defined (make INLINE_TYPES=1)
+// instead stores the types of expressions in the ExpNodes
+// themselves, so that the two layouts can be compared.
 class TypeAnalysis {
 
 private:
 	//The private constructor here means that the type analysis
 	// can only be created via the static build function
-	TypeAnalysis(){
+	TypeAnalysis(size_t nodeCount)
+	: myTable(nodeCount, nullptr), nodeToType(myTable){
 		hasError = false;
 	}
+	//A worker's view of the analysis: the table of node types
+	// is shared with the parent, but the current function and
+	// the error state are the worker's own
+	TypeAnalysis(TypeAnalysis * parent)
+	: nodeToType(parent->nodeToType), ast(parent->ast){
+		hasError = false;
+	}
+	void checkInParallel(size_t workers);
+	//Reports its errors through one of these
+	friend class FlatTypeAnalysis;
 
 public:
-	static TypeAnalysis * build(NameAnalysis * astRoot);
+	//With more than one worker, the globals of the program are
+	// split into runs that are checked concurrently. Each node's
+	// slot in the table is only ever written by one of them.
+	static TypeAnalysis * build(NameAnalysis * astRoot,
+		size_t workers = 1);
+
+	//In the fused mode, names are resolved and types checked in
+	// a single traversal (see ProgramNode::nameAndTypeAnalysis).
+	// Each subtree is checked as soon as its names are resolved,
+	// while it is still in the cache. Type errors are held back
+	// until finishFused, and are dropped if any name fails to
+	// resolve, so the output is what the two passes would give.
+	static TypeAnalysis * startFused(ProgramNode * astIn);
+	template <typename Check>
+	void checkFused(Check check){
+		if (fusedStopped){ return; }
+		DiagnosticsScope diagsScope(&fusedDiags);
+		try {
+			check();
+		} catch (...) {
+			//The separate pass would have stopped here
+			fusedFailure = std::current_exception();
+			fusedStopped = true;
+		}
+	}
+	//Once a name fails, types are not worth checking
+	void stopFused(){ fusedStopped = true; }
+	//Report the held-back type errors, or rethrow what stopped
+	// the checking. Returns whether the program type checks.
+	bool finishFused();
 	//static TypeAnalysis * build();
 
 	//The type analysis has an instance variable to say whether
@@ -48,158 +94,191 @@ public:
 	
 	//Set the type of a node. Note that the function name is 
 	// overloaded: this 2-argument nodeType puts a value into the
-	// map with a given type. 
+	// map with a given type. The table is sized for the whole
+	// tree before checking starts, and is never grown: workers
+	// share it, so growing it would move it under the others.
 	void nodeType(const ASTNode * node, const DataType * type){
-		nodeToType[node] = type;
+		countInsertion();
+		size_t id = node->id();
+		if (id >= nodeToType.size()){
+			throw new InternalError("Node id beyond the type table");
+		}
+		nodeToType[id] = type;
 	}
 
 	//Gets the type of a node already placed in the map. Note
 	// that this function name is overloaded: the 1-argument nodeType
 	// gets the type of the given node out of the map.
 	const DataType * nodeType(const ASTNode * node){
-		const DataType * res = nodeToType[node];
-		if (res == nullptr){
-			const char * msg = "No type for node ";
-			throw new InternalError(msg);
-		}
-		return nodeToType[node];
+		size_t id = node->id();
+		const DataType * res = nullptr;
+		if (id < nodeToType.size()){ res = nodeToType[id]; }
+		return checkType(res);
 	}
 
+#ifdef CMM_INLINE_EXP_TYPES
+	//Expressions (by far the most common nodes) carry their
+	// own type. Overload resolution picks these for any
+	// ExpNode subclass.
+	void nodeType(const ExpNode * node, const DataType * type){
+		countInsertion();
+		node->myType = type;
+	}
+	const DataType * nodeType(const ExpNode * node){
+		return checkType(node->myType);
+	}
+#endif
+
 	//The following functions all report and error and 
 	// tell the object that the analysis has failed. 
-	void errWriteFn(Position * pos){
+	void errWriteFn(const Position * pos){
 		hasError = true;
 		Report::fatal(pos,
 			"Attempt to output a function");
 	}
-	void errWriteVoid(Position * pos){
+	void errWriteVoid(const Position * pos){
 		hasError = true;
 		Report::fatal(pos, 
 			"Attempt to write void");
 	}
-	void errAssignFn(Position * pos){
+	void errAssignFn(const Position * pos){
 		hasError = true;
 		Report::fatal(pos,
 			"Attempt to assign user input to function");
 	}
-	void errReadFn(Position * pos){
+	void errReadFn(const Position * pos){
 		hasError = true;
 		Report::fatal(pos,
 			"Attempt to read a function");
 	}
-	void errCallee(Position * pos){
+	void errCallee(const Position * pos){
 		hasError = true;
 		Report::fatal(pos,
 			"Attempt to call a "
 			"non-function");
 	}
-	void errArgCount(Position * pos){
+	void errArgCount(const Position * pos){
 		hasError = true;
 		Report::fatal(pos,
 			"Function call with wrong"
 			" number of args");
 	}
-	void errArgMatch(Position * pos){
+	void errArgMatch(const Position * pos){
 		hasError = true;
 		Report::fatal(pos, 
 			"Type of actual does not match"
 			" type of formal");
 	}
-	void errRetEmpty(Position * pos){
+	void errRetEmpty(const Position * pos){
 		hasError = true;
 		Report::fatal(pos, 
 			"Missing return value");
 	}
-	void extraRetValue(Position * pos){
+	void extraRetValue(const Position * pos){
 		hasError = true;
 		Report::fatal(pos, 
 			"Return with a value in void"
 			" function");
 	}
-	void errRetWrong(Position * pos){
+	void errRetWrong(const Position * pos){
 		hasError = true;
 		Report::fatal(pos, 
 			"Bad return value");
 	}
-	void errMathOpd(Position * pos){
+	void errMathOpd(const Position * pos){
 		hasError = true;
 		Report::fatal(pos, 
 			"Arithmetic operator applied"
 			" to invalid operand");
 	}
-	void errRelOpd(Position * pos){
+	void errRelOpd(const Position * pos){
 		hasError = true;
 		Report::fatal(pos,
 			"Relational operator applied to"
 			" non-numeric operand");
 	}
-	void errLogicOpd(Position * pos){
+	void errLogicOpd(const Position * pos){
 		hasError = true;
 		Report::fatal(pos,
 			"Logical operator applied to"
 			" non-bool operand");
 	}
-	void errIfCond(Position * pos){
+	void errIfCond(const Position * pos){
 		hasError = true;
 		Report::fatal(pos, 
 			"Non-bool expression used as"
 			" an if condition");
 	}
-	void errWhileCond(Position * pos){
+	void errWhileCond(const Position * pos){
 		hasError = true;
 		Report::fatal(pos,
 			"Non-bool expression used as"
 			" a while condition");
 	}
-	void errEqOpd(Position * pos){
+	void errEqOpd(const Position * pos){
 		hasError = true;
 		Report::fatal(pos, 
 			"Invalid equality operand");
 	}
-	void errEqOpr(Position * pos){
+	void errEqOpr(const Position * pos){
 		hasError = true;
 		Report::fatal(pos, 
 			"Invalid equality operation");
 	}
-	void errNotLVal(Position * pos){
+	void errNotLVal(const Position * pos){
 		hasError = true;
 		Report::fatal(pos, 
 			"Non-Lval assignment");
 	}
-	void errAssignOpd(Position * pos){
+	void errAssignOpd(const Position * pos){
 		hasError = true;
 		Report::fatal(pos, 
 			"Invalid assignment operand");
 	}
-	void errAssignOpr(Position * pos){
+	void errAssignOpr(const Position * pos){
 		hasError = true;
 		Report::fatal(pos, 
 			"Invalid assignment operation");
 	}
-	void errWritePtr(Position * pos){
+	void errWritePtr(const Position * pos){
 		hasError = true;
 		Report::fatal(pos, 
 			"Attempt to write a raw pointer");
 	}
-	void errReadPtr(Position * pos){
+	void errReadPtr(const Position * pos){
 		hasError = true;
 		Report::fatal(pos, 
 			"Attempt to read a raw pointer");
 	}
-	void errDerefOpd(Position * pos){
+	void errDerefOpd(const Position * pos){
 		hasError = true;
 		Report::fatal(pos, 
 			"Invalid operand for dereference");
 	}
-	void errRefOpd(Position * pos){
+	void errRefOpd(const Position * pos){
 		hasError = true;
 		Report::fatal(pos, 
 			"Attempt to read a raw pointer");
 	}
 private:
-	HashMap<const ASTNode *, const DataType *> nodeToType;
-	const FnType * currentFnType;
+	void countInsertion(){
+		if (Stats * stats = Stats::current()){ stats->typeInsertions++; }
+	}
+	const DataType * checkType(const DataType * res){
+		if (res == nullptr){
+			const char * msg = "No type for node ";
+			throw new InternalError(msg);
+		}
+		return res;
+	}
+
+	std::vector<const DataType *> myTable;
+	std::vector<const DataType *>& nodeToType;
+	const FnType * currentFnType = nullptr;
 	bool hasError;
+	Diagnostics fusedDiags;
+	std::exception_ptr fusedFailure;
+	bool fusedStopped = false;
 public:
 	ProgramNode * ast;
 };
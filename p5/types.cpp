@@ -1,14 +1,54 @@
 #include <list>
 #include <sstream>
+#include <unordered_map>
 
 #include "types.hpp"
 #include "ast.hpp"
 
 namespace cminusminus{
 
+const FnType * FnType::produce(const DataType * retType,
+	const Formals& formals){
+	//The component types are already canonical, so a signature
+	// can be hashed and compared on their addresses
+	size_t hash = std::hash<const DataType *>()(retType);
+	for (const DataType * formal : formals){
+		hash = hash * 31 + std::hash<const DataType *>()(formal);
+	}
+
+	static std::unordered_multimap<size_t, FnType *> signatures;
+	static std::mutex signaturesLock;
+	std::lock_guard<std::mutex> guard(signaturesLock);
+	auto range = signatures.equal_range(hash);
+	for (auto itr = range.first; itr != range.second; ++itr){
+		FnType * known = itr->second;
+		if (known->myRetType == retType
+			&& known->myFormalTypes == formals){
+			return known;
+		}
+	}
+	FnType * fresh = new FnType(formals, retType);
+	signatures.emplace(hash, fresh);
+	return fresh;
+}
+
+const BasicType BasicType::primitives[BaseType::SHORT + 1] = {
+	BasicType(BaseType::INT),
+	BasicType(BaseType::VOID),
+	BasicType(BaseType::STRING),
+	BasicType(BaseType::BOOL),
+	BasicType(BaseType::SHORT),
+};
+
+//The scalar types are fixed at compile time
+static_assert(BasicType::INT() != BasicType::BOOL(),
+	"the scalar types must be distinct constants");
+static_assert(BasicType::produce(BaseType::SHORT) == BasicType::SHORT(),
+	"produce must be a constant expression");
+
 std::string BasicType::getString() const{
 	std::string res = "";
-	switch(myBaseType){
+	switch(getBaseType()){
 	case BaseType::INT:
 		res += "int";
 		break;
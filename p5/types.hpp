@@ -1,8 +1,9 @@
 #ifndef CMINUSMINUS_DATA_TYPES
 #define CMINUSMINUS_DATA_TYPES
 
-#include <list>
+#include <mutex>
 #include <sstream>
+#include <vector>
 #include "errors.hpp"
 
 #include <unordered_map>
@@ -28,26 +29,44 @@ enum BaseType{
 	INT, VOID, STRING, BOOL, SHORT
 };
 
+//What kind of type a DataType is. The tags of the scalar types
+// are their BaseType values, so a BasicType's tag is its base.
+enum TypeTag : unsigned char{
+	INT_TAG = BaseType::INT,
+	VOID_TAG = BaseType::VOID,
+	STRING_TAG = BaseType::STRING,
+	BOOL_TAG = BaseType::BOOL,
+	SHORT_TAG = BaseType::SHORT,
+	PTR_TAG,
+	FN_TAG,
+	ERROR_TAG
+};
+
 //This class is the superclass for all cminusminus types. You
 // can get information about which type is implemented
 // concretely using the as<X> functions, or query information
-// using the is<X> functions.
+// using the is<X> functions. Both kinds of query only look at
+// the type's tag, so they are a compare rather than a call.
 class DataType{
 public:
 	virtual std::string getString() const = 0;
-	virtual const BasicType * asBasic() const { return nullptr; }
-	virtual const PtrType * asPtr() const { return nullptr; }
-	virtual const FnType * asFn() const { return nullptr; }
-	virtual const ErrorType * asError() const { return nullptr; }
-	virtual bool isVoid() const { return false; }
-	virtual bool isInt() const { return false; }
-	virtual bool isBool() const { return false; }
-	virtual bool isString() const { return false; }
-	virtual bool isShort() const { return false; }
-	virtual bool isPtr() const { return false; }
+	inline const BasicType * asBasic() const;
+	inline const PtrType * asPtr() const;
+	inline const FnType * asFn() const;
+	inline const ErrorType * asError() const;
+	bool isVoid() const { return myTag == VOID_TAG; }
+	bool isInt() const { return myTag == INT_TAG; }
+	bool isBool() const { return myTag == BOOL_TAG; }
+	bool isString() const { return myTag == STRING_TAG; }
+	bool isShort() const { return myTag == SHORT_TAG; }
+	bool isPtr() const { return myTag == PTR_TAG; }
 	virtual bool validVarType() const = 0 ;
 	virtual size_t getSize() const = 0;
+	TypeTag getTag() const { return myTag; }
 protected:
+	constexpr DataType(TypeTag tagIn) : myTag(tagIn){ }
+private:
+	const TypeTag myTag;
 };
 
 //This DataType subclass is the superclass for all cminusminus types.
@@ -63,14 +82,13 @@ public:
 
 		return error;
 	}
-	virtual const ErrorType * asError() const override { return this; }
 	virtual std::string getString() const override {
 		return "ERROR";
 	}
 	virtual bool validVarType() const override { return false; }
 	virtual size_t getSize() const override { return 0; }
 private:
-	ErrorType(){
+	ErrorType() : DataType(ERROR_TAG){
 		/* private constructor, can only
 		be called from produce */
 	}
@@ -81,73 +99,37 @@ private:
 //DataType subclass for all scalar types
 class BasicType : public DataType{
 public:
-	static BasicType * VOID(){
+	static constexpr const BasicType * VOID(){
 		return produce(BaseType::VOID);
 	}
-	static BasicType * BOOL(){
+	static constexpr const BasicType * BOOL(){
 		return produce(BaseType::BOOL);
 	}
-	static BasicType * STRING(){
+	static constexpr const BasicType * STRING(){
 		return produce(BaseType::STRING);
 	}
-	static BasicType * INT(){
+	static constexpr const BasicType * INT(){
 		return produce(BaseType::INT);
 	}
-	static BasicType * SHORT(){
+	static constexpr const BasicType * SHORT(){
 		return produce(BaseType::SHORT);
 	}
 
-	//Create a scalar type. If that type already exists,
-	// return the known instance of that type. Making sure
-	// there is only 1 instance of a class for a given set
-	// of fields is known as the "flyweight" design pattern
-	// and ensures that the memory needs of a program are kept
-	// down: rather than having a distinct type for every base
-	// INT (for example), only one is constructed and kept in
-	// the flyweights list. That type is then re-used anywhere
-	// it's needed.
-
-	//Note the use of the static function declaration, which
-	// means that no instance of BasicType is needed to call
-	// the function.
-	static BasicType * produce(BaseType base){
-		//Note the use of the static local variable, which
-		//means that the flyweights variable persists between
-		// multiple calls to this function (it is essentially
-		// a global variable that can only be accessed
-		// in this function).
-		static std::list<BasicType *> flyweights;
-		for(BasicType * fly : flyweights){
-			if (fly->getBaseType() == base){
-				return fly;
-			}
-		}
-		BasicType * newType = new BasicType(base);
-		flyweights.push_back(newType);
-		return newType;
-	}
-	const BasicType * asBasic() const override {
-		return this;
-	}
-	BasicType * asBasic(){
-		return this;
-	}
-	bool isInt() const override {
-		return myBaseType == BaseType::INT;
-	}
-	bool isString() const override {
-		return myBaseType == BaseType::STRING;
-	}
-	bool isBool() const override {
-		return myBaseType == BaseType::BOOL;
-	}
-	virtual bool isVoid() const override {
-		return myBaseType == BaseType::VOID;
+	//Get the scalar type for a base. There is exactly one
+	// instance of each, so that two scalar types are equal
+	// exactly when their pointers are (the "flyweight" design
+	// pattern, as for the other types). The instances are
+	// built at compile time, so this is only an address
+	// computation.
+	static constexpr const BasicType * produce(BaseType base){
+		return &primitives[base];
 	}
 	virtual bool validVarType() const override {
 		return !isVoid();
 	}
-	virtual BaseType getBaseType() const { return myBaseType; }
+	BaseType getBaseType() const {
+		return static_cast<BaseType>(getTag());
+	}
 	virtual std::string getString() const override;
 	virtual size_t getSize() const override {
 		if (isBool()){ return 8; }
@@ -157,15 +139,19 @@ public:
 		else { return 0; }
 	}
 private:
-	BasicType(BaseType base)
-	: myBaseType(base){ }
-	BaseType myBaseType;
+	constexpr BasicType(BaseType base)
+	: DataType(static_cast<TypeTag>(base)){ }
+	//Indexed by BaseType. The bound has to be given here for
+	// produce to be a constant expression.
+	static const BasicType primitives[BaseType::SHORT + 1];
 };
 
 class PtrType : public DataType{
 public:
 	static PtrType * produce(const DataType * baseType){
 		static HashMap <const DataType *, PtrType *> map;
+		static std::mutex mapLock;
+		std::lock_guard<std::mutex> guard(mapLock);
 
 		auto res = map.find(baseType);
 		if (res == map.end()){
@@ -181,29 +167,29 @@ public:
 	size_t getSize() const override {
 		return 8;
 	}
-	const PtrType * asPtr() const override { return this; }
-	bool isPtr() const override { return true; }
 	const DataType * getBase() const { return myBase;}
 private:
-	PtrType(const DataType * baseIn) : DataType(), myBase(baseIn){ }
+	PtrType(const DataType * baseIn) : DataType(PTR_TAG), myBase(baseIn){ }
 	const DataType * myBase;
 
 };
 
 //DataType subclass to represent the type of a function. It will
-// have a list of argument types and a return type.
+// have a list of argument types and a return type. Like the other
+// types, function types are flyweights: there is one FnType per
+// signature, so two signatures are the same exactly when their
+// pointers are.
 class FnType : public DataType{
 public:
-	FnType(const std::list<const DataType *>* formalsIn, const DataType * retTypeIn)
-	: DataType(),
-	  myFormalTypes(formalsIn),
-	  myRetType(retTypeIn)
-	{
-	}
+	using Formals = std::vector<const DataType *>;
+
+	static const FnType * produce(const DataType * retType,
+		const Formals& formals);
+
 	std::string getString() const override{
 		std::string result = "";
 		bool first = true;
-		for (auto elt : *myFormalTypes){
+		for (auto elt : myFormalTypes){
 			if (first) { first = false; }
 			else { result += ","; }
 			result += elt->getString();
@@ -212,21 +198,45 @@ public:
 		result += myRetType->getString();
 		return result;
 	}
-	virtual const FnType * asFn() const override { return this; }
-
 	const DataType * getReturnType() const {
 		return myRetType;
 	}
-	const std::list<const DataType *> * getFormalTypes() const {
+	const Formals& getFormalTypes() const {
 		return myFormalTypes;
 	}
 	virtual bool validVarType() const override { return false; }
 	virtual size_t getSize() const override { return 0; }
 private:
-	const std::list<const DataType *> * myFormalTypes;
+	FnType(const Formals& formalsIn, const DataType * retTypeIn)
+	: DataType(FN_TAG),
+	  myFormalTypes(formalsIn),
+	  myRetType(retTypeIn)
+	{
+	}
+	const Formals myFormalTypes;
 	const DataType * myRetType;
 };
 
+const BasicType * DataType::asBasic() const{
+	if (myTag > SHORT_TAG){ return nullptr; }
+	return static_cast<const BasicType *>(this);
+}
+
+const PtrType * DataType::asPtr() const{
+	if (myTag != PTR_TAG){ return nullptr; }
+	return static_cast<const PtrType *>(this);
+}
+
+const FnType * DataType::asFn() const{
+	if (myTag != FN_TAG){ return nullptr; }
+	return static_cast<const FnType *>(this);
+}
+
+const ErrorType * DataType::asError() const{
+	if (myTag != ERROR_TAG){ return nullptr; }
+	return static_cast<const ErrorType *>(this);
+}
+
 }
 
 #endif
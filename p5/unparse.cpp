@@ -312,7 +312,7 @@ void LValNode::unparseNested(std::ostream& out){
 
 void IDNode::unparse(std::ostream& out, int indent){
 	doIndent(out, indent);
-	out << name;
+	out << *name;
 	if (mySymbol != nullptr){
 		out << "("
 		  << mySymbol->getDataType()->getString()
@@ -333,7 +333,7 @@ void ShortLitNode::unparse(std::ostream& out, int indent){
 
 void StrLitNode::unparse(std::ostream& out, int indent){
 	doIndent(out, indent);
-	out << myStr;
+	out.write(myText, static_cast<std::streamsize>(myLen));
 }
 
 void FalseNode::unparse(std::ostream& out, int indent){
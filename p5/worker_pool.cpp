@@ -0,0 +1,62 @@
+#include "worker_pool.hpp"
+
+namespace cminusminus{
+
+WorkerPool::WorkerPool(size_t numWorkers){
+	if (numWorkers == 0){ numWorkers = 1; }
+	for (size_t i = 0; i < numWorkers; i++){
+		workers.push_back(std::thread(&WorkerPool::work, this));
+	}
+}
+
+WorkerPool::~WorkerPool(){
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	jobReady.notify_all();
+	for (std::thread& worker : workers){
+		worker.join();
+	}
+}
+
+size_t WorkerPool::defaultSize(){
+	size_t hw = std::thread::hardware_concurrency();
+	if (hw == 0){ return 1; }
+	return hw;
+}
+
+void WorkerPool::submit(std::function<void()> job){
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		jobs.push_back(job);
+	}
+	jobReady.notify_one();
+}
+
+void WorkerPool::wait(){
+	std::unique_lock<std::mutex> guard(lock);
+	allDone.wait(guard, [this]{ return jobs.empty() && running == 0; });
+}
+
+void WorkerPool::work(){
+	while (true){
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			jobReady.wait(guard, [this]{ return stopping || !jobs.empty(); });
+			if (jobs.empty()){ return; }
+			job = jobs.front();
+			jobs.pop_front();
+			running++;
+		}
+		job();
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			running--;
+			if (jobs.empty() && running == 0){ allDone.notify_all(); }
+		}
+	}
+}
+
+}
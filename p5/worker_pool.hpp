@@ -0,0 +1,43 @@
+#ifndef CMINUSMINUS_WORKER_POOL_HPP
+#define CMINUSMINUS_WORKER_POOL_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cminusminus{
+
+//A fixed-size pool of worker threads. Jobs are handed out in
+// the order they were submitted; the pool itself makes no
+// promise about the order in which they finish, so callers
+// that need deterministic output must put results back in
+// order themselves.
+class WorkerPool{
+public:
+	WorkerPool(size_t numWorkers);
+	~WorkerPool();
+	void submit(std::function<void()> job);
+	//Block until every submitted job has finished
+	void wait();
+	size_t size() const { return workers.size(); }
+
+	//The number of workers to use when none is requested
+	static size_t defaultSize();
+private:
+	void work();
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> jobs;
+	std::mutex lock;
+	std::condition_variable jobReady;
+	std::condition_variable allDone;
+	size_t running = 0;
+	bool stopping = false;
+};
+
+}
+
+#endif